@@ -59,6 +59,7 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 {
     lock->Acquire();			// only one disk I/O at a time
     disk->ReadRequest(sectorNumber, data);
+    kernel->currentThread->usage->numDiskReads++;
     semaphore->P();			// wait for interrupt
     lock->Release();
 }
@@ -77,6 +78,7 @@ SynchDisk::WriteSector(int sectorNumber, char* data)
 {
     lock->Acquire();			// only one disk I/O at a time
     disk->WriteRequest(sectorNumber, data);
+    kernel->currentThread->usage->numDiskWrites++;
     semaphore->P();			// wait for interrupt
     lock->Release();
 }
@@ -50,10 +50,9 @@
 extern "C" {
 #include <signal.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 
-#ifndef NO_MPROT 
-#include <sys/mman.h>
-#endif
+#include <sys/mman.h>	// for mprotect, and mmap (AllocShared)
 
 // UNIX routines called by procedures in this file 
 
@@ -119,6 +118,20 @@ CallOnUserAbort(void (*func)(int))
     (void)signal(SIGINT, func);
 }
 
+//----------------------------------------------------------------------
+// CallOnAbort
+// 	Arrange that "func" will be called when Nachos aborts (e.g., 
+//	because an ASSERT failed), before it drops core.
+//----------------------------------------------------------------------
+
+static void (*abortCleanup)() = NULL;
+
+void 
+CallOnAbort(void (*func)())
+{
+    abortCleanup = func;
+}
+
 //----------------------------------------------------------------------
 // Delay
 // 	Put the UNIX process running Nachos to sleep for x seconds,
@@ -157,6 +170,11 @@ UDelay(unsigned int useconds)
 void 
 Abort()
 {
+    void (*cleanup)() = abortCleanup;
+
+    abortCleanup = NULL;		// in case it aborts too
+    if (cleanup != NULL)
+	(*cleanup)();
     abort();
 }
 
@@ -171,6 +189,100 @@ Exit(int exitCode)
     exit(exitCode);
 }
 
+//----------------------------------------------------------------------
+// ForkProcess
+// 	Make a copy of this UNIX process, which starts out identical to
+//	the original, but runs on independently (and, on a multiprocessor
+//	host, in parallel).  Return 0 in the copy, and the copy's process
+//	id in the original.  Abort on error.
+//----------------------------------------------------------------------
+
+int
+ForkProcess()
+{
+    cout.flush();		// or both copies would print what's buffered
+    int pid = fork();
+    ASSERT(pid >= 0);
+    return pid;
+}
+
+//----------------------------------------------------------------------
+// WaitForProcess
+// 	Wait for one of the copies made by ForkProcess to exit.  Return
+//	FALSE if there are none left to wait for.
+//----------------------------------------------------------------------
+
+bool
+WaitForProcess()
+{
+    int status;
+
+    return wait(&status) >= 0;
+}
+
+//----------------------------------------------------------------------
+// OpenPipe
+// 	Open a one-way channel between processes: whatever is written
+//	to fds[1] can be read from fds[0].  Abort on error.
+//----------------------------------------------------------------------
+
+void
+OpenPipe(int fds[2])
+{
+    int retVal = pipe(fds);
+    ASSERT(retVal >= 0);
+}
+
+//----------------------------------------------------------------------
+// AllocShared
+// 	Return "size" bytes of zeroed memory that the copies later made
+//	by ForkProcess share with the original (and with each other),
+//	rather than each getting their own.  Abort on error.
+//----------------------------------------------------------------------
+
+char *
+AllocShared(int size)
+{
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, 
+			MAP_SHARED | MAP_ANON, -1, 0);
+    ASSERT(p != MAP_FAILED);
+    return (char *) p;
+}
+
+//----------------------------------------------------------------------
+// WaitForFiles
+// 	Wait until one of "count" files has something to read, or for
+//	"msec" milliseconds.  Return which file it was, or -1 if none
+//	did in time.  Entries of -1 in "fds" are skipped.
+//
+//	"fds" -- the file descriptors of the files to wait on
+//----------------------------------------------------------------------
+
+int
+WaitForFiles(int *fds, int count, int msec)
+{
+    fd_set rfd;
+    struct timeval waitTime;
+    int i, maxFd = -1, retVal;
+
+    FD_ZERO(&rfd);
+    for (i = 0; i < count; i++) {
+	if (fds[i] >= 0) {
+	    FD_SET(fds[i], &rfd);
+	    maxFd = max(maxFd, fds[i]);
+	}
+    }
+    waitTime.tv_sec = msec / 1000;
+    waitTime.tv_usec = (msec % 1000) * 1000;
+    retVal = select(maxFd + 1, &rfd, NULL, NULL, &waitTime);
+    if (retVal <= 0)
+	return -1;			// timed out (or a signal came)
+    for (i = 0; i < count; i++)
+	if (fds[i] >= 0 && FD_ISSET(fds[i], &rfd))
+	    return i;
+    return -1;
+}
+
 //----------------------------------------------------------------------
 // RandomInit
 // 	Initialize the pseudo-random number generator.  We use the
@@ -201,6 +313,10 @@ RandomNumber()
 //	the end of the array.  Particularly useful for catching overflow
 //	beyond fixed-size thread execution stacks.
 //
+//	The array is mapped straight from the host, so its pages only
+//	take up memory once they are touched -- most of a thread's stack
+//	never is.
+//
 //	Note: Just return the useful part!
 //
 //	"size" -- amount of useful space needed (in bytes)
@@ -209,43 +325,35 @@ RandomNumber()
 char * 
 AllocBoundedArray(int size)
 {
-#ifdef NO_MPROT
-    return new char[size];
-#else
     int pgSize = getpagesize();
-    char *ptr = new char[pgSize * 2 + size];
-
-    mprotect(ptr, pgSize, 0);
-    mprotect(ptr + pgSize + size, pgSize, 0);
-    return ptr + pgSize;
+    int mapped = pgSize * 2 + divRoundUp(size, pgSize) * pgSize;
+    char *ptr = (char *) mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANON, -1, 0);
+
+    ASSERT(ptr != (char *) MAP_FAILED);
+#ifndef NO_MPROT
+    mprotect(ptr, pgSize, PROT_NONE);
+    mprotect(ptr + mapped - pgSize, pgSize, PROT_NONE);
 #endif
+    return ptr + pgSize;
 }
 
 //----------------------------------------------------------------------
 // DeallocBoundedArray
-// 	Deallocate an array of integers, unprotecting its two boundary pages.
+// 	Deallocate an array from AllocBoundedArray, and its two boundary
+//	pages.
 //
 //	"ptr" -- the array to be deallocated
 //	"size" -- amount of useful space in the array (in bytes)
 //----------------------------------------------------------------------
 
-#ifdef NO_MPROT
-void 
-DeallocBoundedArray(char *ptr, int /* size */)
-{
-    delete [] ptr;
-}
-#else
 void 
 DeallocBoundedArray(char *ptr, int size)
 {
     int pgSize = getpagesize();
 
-    mprotect(ptr - pgSize, pgSize, PROT_READ | PROT_WRITE | PROT_EXEC);
-    mprotect(ptr + size, pgSize, PROT_READ | PROT_WRITE | PROT_EXEC);
-    delete [] (ptr - pgSize);
+    munmap(ptr - pgSize, pgSize * 2 + divRoundUp(size, pgSize) * pgSize);
 }
-#endif
 
 //----------------------------------------------------------------------
 // PollFile
@@ -25,9 +25,20 @@ extern void Exit(int exitCode);
 extern void Delay(int seconds);
 extern void UDelay(unsigned int usec);// rcgood - to avoid spinners.
 
+// Run more than one copy of Nachos at once (see Kernel::StartProcesses)
+extern int ForkProcess();		// 0 in the copy, non-zero in the original
+extern bool WaitForProcess();		// FALSE if there are no copies left
+extern void OpenPipe(int fds[2]);	// fds[0] reads what fds[1] writes
+extern char *AllocShared(int size);	// memory the copies share
+extern int WaitForFiles(int *fds, int count, int msec);
+					// which of "fds" can be read, or -1
+
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(void (*cleanup)(int));
 
+// Have Abort call "cleanup" first, e.g. when an ASSERT fails
+extern void CallOnAbort(void (*cleanup)());
+
 // Initialize the pseudo random number generator
 extern void RandomInit(unsigned seed);
 extern unsigned int RandomNumber();
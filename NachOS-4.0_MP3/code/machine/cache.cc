@@ -0,0 +1,148 @@
+// cache.cc
+//	Routines to emulate a set-associative processor cache.
+//
+//	Only the timing is simulated -- the data always lives in
+//	mainMemory, so the cache never has to be flushed to keep it
+//	correct.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "debug.h"
+#include "cache.h"
+
+//----------------------------------------------------------------------
+// IsPowerOfTwo
+// 	Return TRUE if "n" is a (positive) power of two.
+//----------------------------------------------------------------------
+
+static bool
+IsPowerOfTwo(int n)
+{
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+//----------------------------------------------------------------------
+// Cache::Cache
+// 	Initialize an empty cache.
+//
+//	"debugName" -- what to call the cache when printing statistics
+//	"size" -- bytes of data it holds
+//	"ways" -- lines in each set
+//	"lineBytes" -- bytes in each line
+//	"policy" -- what to do on a write
+//	"penalty" -- ticks to load a line from memory, or write one back
+//----------------------------------------------------------------------
+
+Cache::Cache(char *debugName, int size, int ways, int lineBytes,
+	     WritePolicy policy, int penalty)
+{
+    ASSERT(IsPowerOfTwo(size) && IsPowerOfTwo(ways));
+    ASSERT(IsPowerOfTwo(lineBytes) && lineBytes >= 4);
+    ASSERT(size >= ways * lineBytes);
+    ASSERT(penalty >= 0);
+
+    name = debugName;
+    this->size = size;
+    this->ways = ways;
+    lineSize = lineBytes;
+    numSets = size / (ways * lineBytes);
+    writePolicy = policy;
+    missPenalty = penalty;
+    lines = new CacheLine[numSets * ways];
+    for (int i = 0; i < numSets * ways; i++) {
+	lines[i].tag = -1;
+	lines[i].dirty = FALSE;
+	lines[i].lastUse = 0;
+    }
+    clock = 0;
+    hits = misses = memWrites = 0;
+}
+
+//----------------------------------------------------------------------
+// Cache::~Cache
+// 	De-allocate the cache.
+//----------------------------------------------------------------------
+
+Cache::~Cache()
+{
+    delete [] lines;
+}
+
+//----------------------------------------------------------------------
+// Cache::Access
+// 	Look up the line holding a byte of mainMemory, for a read or a
+//	write, and load it into the cache if it isn't there (unless this
+//	is a write to a write-through cache).  Return the extra ticks the
+//	access costs: nothing on a hit, the miss penalty for loading the
+//	line, and the miss penalty again for writing back the dirty line
+//	it replaces.
+//
+//	"physAddr" -- the physical address being accessed
+//	"writing" -- TRUE if this is a store
+//----------------------------------------------------------------------
+
+int
+Cache::Access(int physAddr, bool writing)
+{
+    int line = physAddr / lineSize;
+    int tag = line / numSets;
+    CacheLine *set = &lines[(line % numSets) * ways];
+    CacheLine *victim;
+    int i, ticks;
+
+    clock++;
+    if (writing && writePolicy == WriteThrough)
+	memWrites++;
+    for (i = 0; i < ways; i++) {
+	if (set[i].tag == tag) {		// hit
+	    hits++;
+	    set[i].lastUse = clock;
+	    if (writing && writePolicy == WriteBack)
+		set[i].dirty = TRUE;
+	    return 0;
+	}
+    }
+
+    misses++;
+    if (writing && writePolicy == WriteThrough)
+	return 0;			// the write buffer takes it
+
+    victim = &set[0];			// an empty line, or else the
+    for (i = 1; i < ways; i++) {	// least recently used one
+	if (victim->tag == -1)
+	    break;
+	if (set[i].tag == -1 || set[i].lastUse < victim->lastUse)
+	    victim = &set[i];
+    }
+    ticks = missPenalty;
+    if (victim->dirty) {
+	memWrites++;
+	ticks += missPenalty;
+    }
+    victim->tag = tag;
+    victim->dirty = writing;
+    victim->lastUse = clock;
+    return ticks;
+}
+
+//----------------------------------------------------------------------
+// Cache::Print
+// 	Print the cache's geometry and how well it did.
+//----------------------------------------------------------------------
+
+void
+Cache::Print()
+{
+    cout << name << ": " << size << " bytes, " << ways << "-way, ";
+    cout << lineSize << "-byte lines, ";
+    cout << ((writePolicy == WriteBack) ? "write-back" : "write-through");
+    cout << "\n\thits " << hits << ", misses " << misses;
+    if (hits + misses > 0)
+	cout << ", hit ratio " << (100.0 * hits) / (hits + misses) << "%";
+    cout << ", memory writes " << memWrites << "\n";
+}
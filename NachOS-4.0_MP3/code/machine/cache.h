@@ -0,0 +1,71 @@
+// cache.h
+//	Data structures to emulate a processor cache.
+//
+//	The cache only models timing: it keeps the tags of the lines
+//	it holds, but not their contents, which are always read from and
+//	written to mainMemory.  Each access reports how many extra ticks
+//	it costs, and the machine adds them to the instruction that made
+//	it (see Machine::instrTicks).
+//
+//	The cache is set associative and physically addressed, with
+//	LRU replacement within a set.  A write-back cache allocates a
+//	line on a write miss, and writes a line back to memory when a
+//	dirty line is replaced; a write-through cache sends every write
+//	to memory, through a write buffer that costs nothing, and doesn't
+//	allocate on a write miss.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+enum WritePolicy { WriteBack, WriteThrough };
+
+// The following class defines one line of a cache.
+
+class CacheLine {
+  public:
+    int tag;		// line address / number of sets, or -1 if the
+			// line is empty
+    bool dirty;		// written since it was loaded (write-back only)
+    int lastUse;	// when it was last accessed, for LRU
+};
+
+// The following class defines a cache.
+
+class Cache {
+  public:
+    Cache(char *debugName, int size, int ways, int lineBytes,
+	  WritePolicy policy, int penalty);
+				// Initialize an empty cache of "size" bytes
+    ~Cache();
+
+    int Access(int physAddr, bool writing);
+				// Look up the line holding physAddr, loading
+				// it if need be; return the extra ticks
+				// the access costs
+
+    void Print();		// print the cache's statistics
+
+    int hits;			// accesses that found their line
+    int misses;			// accesses that didn't
+    int memWrites;		// lines written back (write-back), or
+				// writes sent on to memory (write-through)
+
+  private:
+    char *name;
+    int size, ways, lineSize, numSets;
+    WritePolicy writePolicy;
+    int missPenalty;		// ticks to fetch or write back one line
+    CacheLine *lines;		// numSets sets of "ways" lines each
+    int clock;			// accesses so far, for LRU
+};
+
+#endif // CACHE_H
@@ -30,7 +30,7 @@
 static char *intLevelNames[] = { "off", "on"};
 static char *intTypeNames[] = { "timer", "disk", "console write", 
 			"console read", "network send", 
-			"network recv"};
+			"network recv", "real-time"};
 
 //----------------------------------------------------------------------
 // PendingInterrupt::PendingInterrupt
@@ -48,19 +48,21 @@ PendingInterrupt::PendingInterrupt(CallBackObj *callOnInt,
     callOnInterrupt = callOnInt;
     when = time;
     type = kind;
+    order = 0;
+    nextSpare = NULL;
 }
 
 //----------------------------------------------------------------------
-// PendingCompare
-//	Compare to interrupts based on which should occur first.
+// PendingBefore
+//	Return TRUE if interrupt "x" should occur before "y": it is due
+//	sooner, or at the same time but was scheduled first.
 //----------------------------------------------------------------------
 
-static int
-PendingCompare (PendingInterrupt *x, PendingInterrupt *y)
+static bool
+PendingBefore (PendingInterrupt *x, PendingInterrupt *y)
 {
-    if (x->when < y->when) { return -1; }
-    else if (x->when > y->when) { return 1; }
-    else { return 0; }
+    if (x->when != y->when) { return x->when < y->when; }
+    return x->order - y->order < 0;
 }
 
 //----------------------------------------------------------------------
@@ -73,7 +75,11 @@ PendingCompare (PendingInterrupt *x, PendingInterrupt *y)
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new SortedList<PendingInterrupt *>(PendingCompare);
+    maxPending = 16;
+    pending = new PendingInterrupt *[maxPending];
+    numPending = 0;
+    numScheduled = 0;
+    spare = NULL;
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
@@ -86,10 +92,17 @@ Interrupt::Interrupt()
 
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty()) {
-	delete pending->RemoveFront();
+    PendingInterrupt *next;
+
+    for (int i = 0; i < numPending; i++) {
+	delete pending[i];
+    }
+    delete [] pending;
+    while (spare != NULL) {
+	next = spare->nextSpare;
+	delete spare;
+	spare = next;
     }
-    delete pending;
 }
 
 //----------------------------------------------------------------------
@@ -155,9 +168,11 @@ Interrupt::OneTick()
     if (status == SystemMode) {
         stats->totalTicks += SystemTick;
 	stats->systemTicks += SystemTick;
+	kernel->currentThread->usage->systemTicks += SystemTick;
     } else {
 	stats->totalTicks += UserTick;
 	stats->userTicks += UserTick;
+	kernel->currentThread->usage->userTicks += UserTick;
     }
     DEBUG(dbgInt, "== Tick " << stats->totalTicks << " ==");
 
@@ -179,43 +194,75 @@ Interrupt::OneTick()
     }
 
     //check aging & readytorun
-    ListIterator<Thread *> *iterL1 = new ListIterator<Thread *>(kernel->scheduler->QueueL1);
-    ListIterator<Thread *> *iterL2 = new ListIterator<Thread *>(kernel->scheduler->QueueL2);
-    ListIterator<Thread *> *iterL3 = new ListIterator<Thread *>(kernel->scheduler->QueueL3);
-
-    for(; !iterL1->IsDone(); iterL1->Next()){
-        Thread *t = iterL1->Item();
-        bool getToHigherQueue = kernel->scheduler->CheckAging(t);
-        //check if new comming L1 process has smaller burst time
-        //or current thread is in lower layer queue => preempt
-        if(t->getJump() && kernel->currentThread->getID() != t->getID()){
-            cout<<"Preempt: L1\n";
-            t->setJump(false);
-            kernel->currentThread->Yield();
-        }
+    kernel->scheduler->CheckReadyQueues();
+}
+
+//----------------------------------------------------------------------
+// Interrupt::QuietTicks
+// 	Return how many of the coming calls to OneTick will do nothing
+//	but advance the clock: no pending interrupt falls due, the
+//	current round-robin time slice doesn't run out, and nothing 
+//	happens in the ready queues.  The machine may run that many
+//	user instructions and then call SkipTicks once, with the same
+//	result as calling OneTick after each of them.
+//
+//	Returns 0 if there is any doubt, including when the interrupt 
+//	trace is being printed.
+//----------------------------------------------------------------------
+
+int
+Interrupt::QuietTicks()
+{
+    Statistics *stats = kernel->stats;
+    Thread *current = kernel->currentThread;
+    int tick = (status == SystemMode) ? SystemTick : UserTick;
+    int count, when;
+
+    if (numPending == 0 || debug->IsEnabled(dbgInt)) {
+	return 0;
     }
-    for (; !iterL2->IsDone(); iterL2->Next())
-    {
-        Thread* t = iterL2->Item();
-        bool getToHigherQueue = kernel->scheduler->CheckAging(t);
-        //may change the priority => requeue
-        if(!getToHigherQueue && t->getID()>=2) {
-            if(kernel->scheduler->QueueL2->IsInList(t)){
-                kernel->scheduler->QueueL2->Remove(t);
-            }
-            kernel->scheduler->QueueL2->Insert(t);
-        }
-        //check if current thread is in lower layer queue => preempt
-        if(t->getJump() && kernel->currentThread->getID() != t->getID()){
-            cout<<"Preempt: L2\n";
-            t->setJump(false);
-            kernel->currentThread->Yield();
-        }
+    when = kernel->scheduler->NextEventTime(pending[0]->when);
+    count = (when - stats->totalTicks - 1) / tick;
+
+    //MP3
+    //RR: OneTick yields once the thread has used up 100 user ticks
+    //(user code is charged as system time after a preemption in
+    //OneTick, which doesn't reset the status; then it never runs out)
+    if (yieldOnReturn && current->getPriority() <= 49) {
+	int left = current->getStartTime() + 100 - stats->userTicks;
+	if (left <= 0) {
+	    return 0;
+	} else if (status != SystemMode) {
+	    count = min(count, divRoundUp(left, UserTick) - 1);
+	}
     }
+    return max(count, 0);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::SkipTicks
+// 	Advance simulated time by "count" ticks, as that many calls
+//	to OneTick would, but without checking for interrupts.  The
+//	caller must not skip more ticks than QuietTicks() allows.
+//
+//	"count" -- how many ticks to skip
+//----------------------------------------------------------------------
+
+void
+Interrupt::SkipTicks(int count)
+{
+    Statistics *stats = kernel->stats;
 
-    for (; !iterL3->IsDone(); iterL3->Next()){
-        bool getToHigherQueue = kernel->scheduler->CheckAging(iterL3->Item());
+    if (status == SystemMode) {
+	stats->totalTicks += count * SystemTick;
+	stats->systemTicks += count * SystemTick;
+	kernel->currentThread->usage->systemTicks += count * SystemTick;
+    } else {
+	stats->totalTicks += count * UserTick;
+	stats->userTicks += count * UserTick;
+	kernel->currentThread->usage->userTicks += count * UserTick;
     }
+    kernel->scheduler->SkipChecks(count);
 }
 
 //----------------------------------------------------------------------
@@ -276,9 +323,12 @@ Interrupt::Idle()
 void
 Interrupt::Halt()
 {
+    kernel->schedLog->Print();		// -slog
     cout << "Machine halting!\n\n";
     cout << "This is halt\n";
     kernel->stats->Print();
+    kernel->PrintProfile();
+    kernel->SendStatistics();
     delete kernel;	// Never returns.
 }
 /*HW1-1: PrintInt(int)*/
@@ -336,12 +386,87 @@ void
 Interrupt::Schedule(CallBackObj *toCall, int fromNow, IntType type)
 {
     int when = kernel->stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(toCall, when, type);
+    PendingInterrupt *toOccur;
 
     DEBUG(dbgInt, "Scheduling interrupt handler the " << intTypeNames[type] << " at time = " << when);
     ASSERT(fromNow > 0);
 
-    pending->Insert(toOccur);
+    if (spare != NULL) {		// the devices re-arm all the time,
+	toOccur = spare;		// so reuse an interrupt that fired
+	spare = spare->nextSpare;
+	toOccur->callOnInterrupt = toCall;
+	toOccur->when = when;
+	toOccur->type = type;
+    } else {
+	toOccur = new PendingInterrupt(toCall, when, type);
+    }
+    toOccur->order = numScheduled++;
+    Push(toOccur);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Push
+// 	Add an interrupt to the heap of pending ones, growing it if need 
+//	be.  The heap is kept so that each interrupt occurs no later 
+//	than its two children, at 2i+1 and 2i+2; so the next interrupt 
+//	to occur is always at the top, and adding or removing one takes
+//	time proportional to the log of the number pending.
+//
+//	"toOccur" -- the interrupt to add
+//----------------------------------------------------------------------
+
+void
+Interrupt::Push(PendingInterrupt *toOccur)
+{
+    int i, parent;
+
+    if (numPending == maxPending) {
+	PendingInterrupt **bigger = new PendingInterrupt *[maxPending * 2];
+
+	for (i = 0; i < numPending; i++) {
+	    bigger[i] = pending[i];
+	}
+	delete [] pending;
+	pending = bigger;
+	maxPending *= 2;
+    }
+    for (i = numPending++; i > 0; i = parent) {	// move it up into place
+	parent = (i - 1) / 2;
+	if (!PendingBefore(toOccur, pending[parent])) {
+	    break;
+	}
+	pending[i] = pending[parent];
+    }
+    pending[i] = toOccur;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Pop
+// 	Remove the next interrupt to occur from the heap of pending ones,
+//	and return it.  There must be one.
+//----------------------------------------------------------------------
+
+PendingInterrupt *
+Interrupt::Pop()
+{
+    PendingInterrupt *next, *last;
+    int i, child;
+
+    ASSERT(numPending > 0);
+    next = pending[0];
+    last = pending[--numPending];
+    for (i = 0; (child = 2 * i + 1) < numPending; i = child) {
+	if (child + 1 < numPending 	// move the last one down into place
+		&& PendingBefore(pending[child + 1], pending[child])) {
+	    child++;
+	}
+	if (!PendingBefore(pending[child], last)) {
+	    break;
+	}
+	pending[i] = pending[child];
+    }
+    pending[i] = last;
+    return next;
 }
 
 //----------------------------------------------------------------------
@@ -367,10 +492,10 @@ Interrupt::CheckIfDue(bool advanceClock)
     if (debug->IsEnabled(dbgInt)) {
 	DumpState();
     }
-    if (pending->IsEmpty()) {   	// no pending interrupts
+    if (numPending == 0) {   	// no pending interrupts
 	return FALSE;	
     }		
-    next = pending->Front();
+    next = pending[0];
 
     if (next->when > stats->totalTicks) {
         if (!advanceClock) {		// not time yet
@@ -392,11 +517,14 @@ Interrupt::CheckIfDue(bool advanceClock)
 
     inHandler = TRUE;
     do {
-        next = pending->RemoveFront();    // pull interrupt off list
+        next = Pop();    		// pull interrupt off heap
+	if (kernel->machine != NULL && kernel->machine->trace != NULL)
+	    kernel->machine->trace->Record(TraceInterrupt, next->type, 0);
         next->callOnInterrupt->CallBack();// call the interrupt handler
-	delete next;
-    } while (!pending->IsEmpty() 
-    		&& (pending->Front()->when <= stats->totalTicks));
+	next->nextSpare = spare;	// keep it for the next Schedule
+	spare = next;
+    } while (numPending > 0 
+    		&& (pending[0]->when <= stats->totalTicks));
     inHandler = FALSE;
     return TRUE;
 }
@@ -423,10 +551,22 @@ PrintPending (PendingInterrupt *pending)
 void
 Interrupt::DumpState()
 {
+    PendingInterrupt **sorted = new PendingInterrupt *[maxPending];
+    int i, j;
+
     cout << "Time: " << kernel->stats->totalTicks;
     cout << ", interrupts " << intLevelNames[level] << "\n";
     cout << "Pending interrupts:\n";
-    pending->Apply(PrintPending);
+    for (i = 0; i < numPending; i++) {	// the heap is only partly sorted
+	for (j = i; j > 0 && PendingBefore(pending[i], sorted[j - 1]); j--) {
+	    sorted[j] = sorted[j - 1];
+	}
+	sorted[j] = pending[i];
+    }
+    for (i = 0; i < numPending; i++) {
+	PrintPending(sorted[i]);
+    }
+    delete [] sorted;
     cout << "\nEnd of pending interrupts\n";
 }
 
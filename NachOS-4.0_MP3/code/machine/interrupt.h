@@ -48,9 +48,10 @@ enum MachineStatus {IdleMode, SystemMode, UserMode};
 
 // IntType records which hardware device generated an interrupt.
 // In Nachos, we support a hardware timer device, a disk, a console
-// display and keyboard, and a network.
+// display and keyboard, and a network; and the scheduler sets an
+// alarm for its real-time threads (see Scheduler::CallBack).
 enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt, 
-			NetworkSendInt, NetworkRecvInt};
+			NetworkSendInt, NetworkRecvInt, RealTimeInt};
 
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
@@ -67,6 +68,9 @@ class PendingInterrupt {
     
     int when;			// When the interrupt is supposed to fire
     IntType type;		// for debugging
+    int order;			// interrupts due at the same time fire
+				// in the order they were scheduled
+    PendingInterrupt *nextSpare;// next on the list of spare ones
 };
 
 // The following class defines the data structures for the simulation
@@ -124,11 +128,20 @@ class Interrupt {
     
     void OneTick();       	// Advance simulated time
 
+    int QuietTicks();		// How many more calls to OneTick will
+				// do nothing but advance the clock
+    void SkipTicks(int count);	// Advance simulated time as that many
+				// calls to OneTick would
+
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    SortedList<PendingInterrupt *> *pending;		
-    				// the list of interrupts scheduled
-				// to occur in the future
+    PendingInterrupt **pending;	// a heap of the interrupts scheduled
+				// to occur in the future, the next
+				// one to fire at pending[0]
+    int numPending;		// how many are in the heap
+    int maxPending;		// how many it has room for
+    int numScheduled;		// interrupts scheduled so far
+    PendingInterrupt *spare;	// fired interrupts, to be reused
     //int writeFileNo;            //UNIX file emulating the display
     bool inHandler;		// TRUE if we are running an interrupt handler
     //bool putBusy;               // Is a PrintInt operation in progress
@@ -145,6 +158,9 @@ class Interrupt {
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 			IntStatus now); // simulated time
+
+    void Push(PendingInterrupt *toOccur);// add to the heap
+    PendingInterrupt *Pop();		// take the next one off the heap
 };
 
 #endif // INTERRRUPT_H
@@ -9,6 +9,9 @@
 
 #include "copyright.h"
 #include "machine.h"
+#include "mipssim.h"
+#include "cache.h"
+#include "trace.h"
 #include "main.h"
 
 // Textual names of the exceptions that can be generated by user program
@@ -50,9 +53,23 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"blocks" -- if TRUE, run user code with the basic-block engine
+//		(RunBlocks) rather than one instruction at a time.
+//	"tlbEntries" -- if non-zero, translate addresses with a TLB of
+//		that many entries, rather than a linear page table.
+//	"policy" -- which TLB entry TLBVictim suggests replacing.
+//	"profile" -- if TRUE, count the instructions run by opcode and 
+//		by PC (see PrintProfile).
+//	"costs" -- how many ticks to charge each instruction, or NULL for
+//		one apiece.
+//	"instrCache", "dataCache" -- if not NULL, the caches instruction
+//		fetches and loads and stores go through; each miss adds
+//		to the cost of the instruction.  They belong to our caller.
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, bool blocks, int tlbEntries, TLBPolicy policy,
+		 bool profile, CostModel *costs, Cache *instrCache,
+		 Cache *dataCache, Trace *tracer)
 {
     int i;
 
@@ -61,17 +78,60 @@ Machine::Machine(bool debug)
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
-#ifdef USE_TLB
-    tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
-	tlb[i].valid = FALSE;
-    pageTable = NULL;
-#else	// use linear page table
-    tlb = NULL;
+    decodeCache = new Instruction[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++)
+	decodeCache[i].opCode = OP_NOTDECODED;
+    blockCache = new BasicBlock *[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++)
+	blockCache[i] = NULL;
+    blocksInPage = new int[NumPhysPages];
+    for (i = 0; i < NumPhysPages; i++)
+	blocksInPage[i] = 0;
+    blocksDropped = FALSE;
+    fusionCounts = new int[NumFusions];
+    for (i = 0; i < NumFusions; i++)
+	fusionCounts[i] = 0;
+    ticksOwed = 0;
+    tlbSize = tlbEntries;
+    tlbPolicy = policy;
+    tlbNext = 0;
+    tlbClock = 0;
+    currentASID = 0;
+    if (tlbSize > 0) {
+	tlb = new TranslationEntry[tlbSize];
+	tlbLastUse = new int[tlbSize];
+	for (i = 0; i < tlbSize; i++) {
+	    tlb[i].valid = FALSE;
+	    tlbLastUse[i] = 0;
+	}
+    } else {	// use linear page table
+	tlb = NULL;
+	tlbLastUse = NULL;
+    }
     pageTable = NULL;
-#endif
+    if (profile) {
+	opCounts = new int[MaxOpcode + 1];
+	for (i = 0; i <= MaxOpcode; i++)
+	    opCounts[i] = 0;
+    } else
+	opCounts = NULL;
+    pcCounts = NULL;
+    pcCountsSize = 0;
+    costModel = costs;
+    if (costModel != NULL) {
+	opTicks = new int[MaxOpcode + 1];
+	for (i = 0; i <= MaxOpcode; i++)
+	    opTicks[i] = costModel->classTicks[opCostTable[i].instrClass];
+    } else
+	opTicks = NULL;
+    instrTicks = 1;
+    icache = instrCache;
+    dcache = dataCache;
+    trace = tracer;
 
+    FlushTranslations();
     singleStep = debug;
+    useBlocks = blocks;
     CheckEndian();
 }
 
@@ -83,8 +143,100 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
-    if (tlb != NULL)
+    for (int i = 0; i < NumPhysPages; i++)
+	DropBlocks(i * PageSize, PageSize);
+    delete [] decodeCache;
+    delete [] blockCache;
+    delete [] blocksInPage;
+    delete [] fusionCounts;
+    if (tlb != NULL) {
         delete [] tlb;
+        delete [] tlbLastUse;
+    }
+    if (opCounts != NULL)
+        delete [] opCounts;
+    if (opTicks != NULL)
+        delete [] opTicks;
+}
+
+//----------------------------------------------------------------------
+// Machine::TLBVictim
+// 	Return the index of the TLB entry the kernel should overwrite to
+//	make room for a new translation: an invalid entry if there is 
+//	one, otherwise the one picked by the replacement policy.  Like
+//	the Random register of the R2000/3000, this is only a suggestion
+//	from the hardware; loading the entry is up to the kernel.
+//----------------------------------------------------------------------
+
+int
+Machine::TLBVictim()
+{
+    int i, victim;
+
+    ASSERT(tlb != NULL);
+    for (i = 0; i < tlbSize; i++)
+	if (!tlb[i].valid)
+	    return i;
+
+    switch (tlbPolicy) {
+      case TLBFifo:			// the one loaded longest ago
+	victim = tlbNext;
+	tlbNext = (tlbNext + 1) % tlbSize;
+	break;
+      case TLBLru:			// the one used longest ago
+	victim = 0;
+	for (i = 1; i < tlbSize; i++)
+	    if (tlbLastUse[i] < tlbLastUse[victim])
+		victim = i;
+	break;
+      case TLBRandom:
+	victim = RandomNumber() % tlbSize;
+	break;
+      default:
+	ASSERT(FALSE);
+    }
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushTranslations
+// 	Throw away the translations Translate has cached in hostReadCache
+//	and hostWriteCache, so the next access to each page goes through
+//	the page table (or TLB) again.  The kernel must call this when it
+//	switches page tables, or changes an entry that may have been used
+//	-- including clearing its use or dirty bit, since those are only
+//	set the first time the page is touched after a flush.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushTranslations()
+{
+    for (int i = 0; i < HostCacheSize; i++) {
+	hostReadCache[i].virtualPage = -1;
+	hostWriteCache[i].virtualPage = -1;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateDecodedPage
+// 	Throw away the predecoded instructions for one physical page,
+//	so that they are decoded again from mainMemory the next time they
+//	are fetched, along with any basic blocks built from them.
+//	WriteMem does this for the words it stores to; the kernel must
+//	do it for frames it fills in directly.
+//
+//	"physPage" -- the physical page number of the frame
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateDecodedPage(int physPage)
+{
+    ASSERT((physPage >= 0) && (physPage < NumPhysPages));
+    Instruction *instr = &decodeCache[physPage * PageSize / 4];
+
+    for (int i = 0; i < PageSize / 4; i++)
+	instr[i].opCode = OP_NOTDECODED;
+    DropBlocks(physPage * PageSize, PageSize);
 }
 
 //----------------------------------------------------------------------
@@ -102,9 +254,23 @@ Machine::RaiseException(ExceptionType which, int badVAddr)
 {
     DEBUG(dbgMach, "Exception: " << exceptionNames[which]);
     registers[BadVAddrReg] = badVAddr;
+    if (trace != NULL) {
+	if (which == SyscallException)
+	    trace->Record(TraceSyscall, registers[2], 0);
+	else
+	    trace->Record(TraceFault, which, badVAddr);
+    }
+    // charge the instructions run since the clock was last updated,
+    // and all but the last tick of this one (our caller does OneTick
+    // for that), so the kernel sees the time of the trap
+    if (ticksOwed + instrTicks > 1)
+	kernel->interrupt->SkipTicks(ticksOwed + instrTicks - 1);
+    ticksOwed = 0;
     DelayedLoad(0, 0);			// finish anything in progress
     kernel->interrupt->setStatus(SystemMode);
+    kernel->currentThread->setUserLevel(FALSE);
     ExceptionHandler(which);		// interrupts are enabled at this point
+    kernel->currentThread->setUserLevel(TRUE);
     kernel->interrupt->setStatus(UserMode);
 }
 
@@ -39,6 +39,14 @@ const int NumPhysPages = 128;
 
 const int MemorySize = (NumPhysPages * PageSize);
 const int TLBSize = 4;			// if there is a TLB, make it small
+					// (default size; see Kernel -tlb)
+const int NumASIDs = 64;		// address space ids a TLB entry can
+					// be tagged with
+
+enum TLBPolicy { TLBFifo, TLBLru, TLBRandom };
+					// which TLB entry TLBVictim picks
+const int HostCacheSize = 16;		// translations cached by the simulator
+					// itself, for each kind of access
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -89,11 +97,18 @@ enum ExceptionType { NoException,           // Everything ok!
 // translate.cc.
 
 class Instruction;
+class BasicBlock;
 class Interrupt;
+class CostModel;
+class Cache;
+class Trace;
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
+    Machine(bool debug, bool blocks, int tlbEntries, TLBPolicy policy,
+	    bool profile, CostModel *costs, Cache *instrCache,
+	    Cache *dataCache, Trace *tracer);
+				// Initialize the simulation of the hardware
 				// for running user programs
     ~Machine();			// De-allocate the data structures
 
@@ -134,6 +149,12 @@ class Machine {
 
     TranslationEntry *tlb;		// this pointer should be considered 
 					// "read-only" to Nachos kernel code
+    int tlbSize;			// number of entries in the TLB
+    int currentASID;			// only TLB entries tagged with this 
+					// address space id are used
+
+    int TLBVictim();			// index of the TLB entry to replace
+					// on a TLB miss
 
     TranslationEntry *pageTable;
     unsigned int pageTableSize;
@@ -143,16 +164,67 @@ class Machine {
     				// Read or write 1, 2, or 4 bytes of virtual 
 				// memory (at addr).  Return FALSE if a 
 				// correct translation couldn't be found.
+
+    void FlushTranslations();	// Forget the cached translations; call
+				// this whenever the page table or TLB
+				// pointer, or any entry in it, changes
+
+    void InvalidateDecodedPage(int physPage);
+				// Forget the predecoded instructions for a
+				// physical page; call this whenever the kernel
+				// hands the frame to a new address space or
+				// writes it without going through WriteMem
+
+// When profiling, the machine counts the instructions it runs, by 
+// opcode and by (virtual) PC.  The PC histogram, one counter per word,
+// belongs to the running address space; like the page table, the
+// kernel installs it on a context switch.
+
+    bool Profiling() { return opCounts != NULL; }
+    int *pcCounts;
+    unsigned int pcCountsSize;
+    void PrintProfile();	// print the opcode counts, most common first
+    void PrintFusions();	// print how often each fused pair of
+				// instructions ran in the basic-block engine
+
+// When tracing, the machine records every fetch, load, store and trap
+// (see trace.h); the kernel adds interrupts and address space switches.
+
+    Trace *trace;		// where to record them, or NULL
+    int Replay(Trace *from);	// play back a trace through the TLB and
+				// caches, instead of running a program;
+				// return the ticks cache misses would cost
   private:
 
 // Routines internal to the machine simulation -- DO NOT call these directly
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
 
-    void OneInstruction(Instruction *instr); 	
-    				// Run one instruction of a user program.
-    
-
+    bool OneInstruction(); 	// Run one instruction of a user program.
+				// Return FALSE if it trapped to the kernel.
+    void ChargeInstruction(Instruction *instr, int pcAfter);
+				// Work out instrTicks for an instruction
+				// that has just run, by the cost model
+
+    void RunBlocks();		// Run the user program a basic block
+				// at a time (see mipssim.cc)
+    BasicBlock *BuildBlock(int physAddr, void **opLabel, void **fuseLabel);
+				// Make the block starting at physAddr
+    void DropBlocks(int physAddr, int size);
+				// Forget the blocks holding any of these
+				// bytes of mainMemory
+
+
+    char *HostAddress(int virtAddr, int size, bool writing) {
+	unsigned int vpn = (unsigned) virtAddr / PageSize;
+	HostTranslation *cached = writing ? &hostWriteCache[vpn % HostCacheSize]
+					  : &hostReadCache[vpn % HostCacheSize];
+	if (cached->virtualPage != (int) vpn || (virtAddr & (size - 1)))
+	    return NULL;
+	return cached->hostPage + (unsigned) virtAddr % PageSize; }
+				// Where an access to virtAddr goes in 
+				// mainMemory, if a recent Translate has 
+				// already checked it; otherwise NULL
 
     ExceptionType Translate(int virtAddr, int* physAddr, int size,bool writing);
     				// Translate an address, and check for 
@@ -173,12 +245,48 @@ class Machine {
 
     int registers[NumTotalRegs]; // CPU registers, for executing user programs
 
+    HostTranslation hostReadCache[HostCacheSize];
+    HostTranslation hostWriteCache[HostCacheSize];
+				// recent translations for reads (and
+				// fetches) and for writes, direct mapped
+				// by virtual page number
+
+    Instruction *decodeCache;	// decoded copy of each word of mainMemory,
+				// filled in the first time it is fetched
+
+    BasicBlock **blockCache;	// the block starting at each word of 
+				// mainMemory, if any
+    int *blocksInPage;		// how many blocks each physical page holds
+    bool blocksDropped;		// a store has thrown some blocks away
+    int *fusionCounts;		// times each fused pair has been run
+    TLBPolicy tlbPolicy;	// how TLBVictim chooses
+    int tlbNext;		// next entry to replace, for TLBFifo
+    int *tlbLastUse;		// when each TLB entry was last used, 
+    int tlbClock;		// in TLB lookups, for TLBLru
+
+    int *opCounts;		// instructions run with each opcode, or
+				// NULL if we aren't profiling
+
+    bool useBlocks;		// run with RunBlocks instead of
+				// OneInstruction
+    int ticksOwed;		// ticks for instructions that have been
+				// run but not charged to the clock yet 
+				// (see Run)
+    CostModel *costModel;	// what instructions cost, or NULL for
+				// one tick apiece
+    int *opTicks;		// cost of each opcode, from costModel
+    int instrTicks;		// cost of the last instruction run,
+				// including any cache misses
+    Cache *icache;		// caches for instruction fetches and
+    Cache *dcache;		// for loads and stores, or NULL
+
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
 				// time reaches this value
 
     friend class Interrupt;		// calls DelayedLoad()    
+    friend class AddrSpace;		// raises faults for CopyIn and CopyOut
 };
 
 extern void ExceptionHandler(ExceptionType which);
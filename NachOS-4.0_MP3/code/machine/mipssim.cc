@@ -20,28 +20,182 @@
 #include "debug.h"
 #include "machine.h"
 #include "mipssim.h"
+#include "cache.h"
+#include "trace.h"
 #include "main.h"
 
 static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 
-// The following class defines an instruction, represented in both
-// 	undecoded binary form
-//      decoded to identify
-//	    operation to do
-//	    registers to act on
-//	    any immediate operand value
+// How to decode bits 31:26 of an instruction, and the "funct" field of
+// a SPECIAL one (see mipssim.h).
 
-class Instruction {
-  public:
-    void Decode();	// decode the binary representation of the instruction
+const OpInfo opTable[] = {
+    {SPECIAL, RFMT}, {BCOND, IFMT}, {OP_J, JFMT}, {OP_JAL, JFMT},
+    {OP_BEQ, IFMT}, {OP_BNE, IFMT}, {OP_BLEZ, IFMT}, {OP_BGTZ, IFMT},
+    {OP_ADDI, IFMT}, {OP_ADDIU, IFMT}, {OP_SLTI, IFMT}, {OP_SLTIU, IFMT},
+    {OP_ANDI, IFMT}, {OP_ORI, IFMT}, {OP_XORI, IFMT}, {OP_LUI, IFMT},
+    {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT},
+    {OP_LB, IFMT}, {OP_LH, IFMT}, {OP_LWL, IFMT}, {OP_LW, IFMT},
+    {OP_LBU, IFMT}, {OP_LHU, IFMT}, {OP_LWR, IFMT}, {OP_RES, IFMT},
+    {OP_SB, IFMT}, {OP_SH, IFMT}, {OP_SWL, IFMT}, {OP_SW, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_SWR, IFMT}, {OP_RES, IFMT},
+    {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT},
+    {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}
+};
+
+const int specialTable[] = {
+    OP_SLL, OP_RES, OP_SRL, OP_SRA, OP_SLLV, OP_RES, OP_SRLV, OP_SRAV,
+    OP_JR, OP_JALR, OP_RES, OP_RES, OP_SYSCALL, OP_UNIMP, OP_RES, OP_RES,
+    OP_MFHI, OP_MTHI, OP_MFLO, OP_MTLO, OP_RES, OP_RES, OP_RES, OP_RES,
+    OP_MULT, OP_MULTU, OP_DIV, OP_DIVU, OP_RES, OP_RES, OP_RES, OP_RES,
+    OP_ADD, OP_ADDU, OP_SUB, OP_SUBU, OP_AND, OP_OR, OP_XOR, OP_NOR,
+    OP_RES, OP_RES, OP_SLT, OP_SLTU, OP_RES, OP_RES, OP_RES, OP_RES,
+    OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES,
+    OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES
+};
 
-    unsigned int value; // binary representation of the instruction
+// For each "opCode", the class the cost model charges it as, and which
+// of the rs and rt registers it reads (see mipssim.h).
 
-    char opCode;     // Type of instruction.  This is NOT the same as the
-    		     // opcode field from the instruction: see defs in mips.h
-    char rs, rt, rd; // Three registers from instruction.
-    int extra;       // Immediate or target or shamt field or offset.
-                     // Immediates are sign-extended.
+const OpCost opCostTable[] = {
+    {AluClass, 0},			/* not an opcode */
+    {AluClass, READS_RS | READS_RT},	/* ADD */
+    {AluClass, READS_RS},		/* ADDI */
+    {AluClass, READS_RS},		/* ADDIU */
+    {AluClass, READS_RS | READS_RT},	/* ADDU */
+    {AluClass, READS_RS | READS_RT},	/* AND */
+    {AluClass, READS_RS},		/* ANDI */
+    {BranchClass, READS_RS | READS_RT},	/* BEQ */
+    {BranchClass, READS_RS},		/* BGEZ */
+    {BranchClass, READS_RS},		/* BGEZAL */
+    {BranchClass, READS_RS},		/* BGTZ */
+    {BranchClass, READS_RS},		/* BLEZ */
+    {BranchClass, READS_RS},		/* BLTZ */
+    {BranchClass, READS_RS},		/* BLTZAL */
+    {BranchClass, READS_RS | READS_RT},	/* BNE */
+    {AluClass, 0},			/* not an opcode */
+    {DivClass, READS_RS | READS_RT},	/* DIV */
+    {DivClass, READS_RS | READS_RT},	/* DIVU */
+    {JumpClass, 0},			/* J */
+    {JumpClass, 0},			/* JAL */
+    {JumpClass, READS_RS},		/* JALR */
+    {JumpClass, READS_RS},		/* JR */
+    {LoadClass, READS_RS},		/* LB */
+    {LoadClass, READS_RS},		/* LBU */
+    {LoadClass, READS_RS},		/* LH */
+    {LoadClass, READS_RS},		/* LHU */
+    {AluClass, 0},			/* LUI */
+    {LoadClass, READS_RS},		/* LW */
+    {LoadClass, READS_RS | READS_RT},	/* LWL */
+    {LoadClass, READS_RS | READS_RT},	/* LWR */
+    {AluClass, 0},			/* not an opcode */
+    {AluClass, 0},			/* MFHI */
+    {AluClass, 0},			/* MFLO */
+    {AluClass, 0},			/* not an opcode */
+    {AluClass, READS_RS},		/* MTHI */
+    {AluClass, READS_RS},		/* MTLO */
+    {MultClass, READS_RS | READS_RT},	/* MULT */
+    {MultClass, READS_RS | READS_RT},	/* MULTU */
+    {AluClass, READS_RS | READS_RT},	/* NOR */
+    {AluClass, READS_RS | READS_RT},	/* OR */
+    {AluClass, READS_RS},		/* ORI */
+    {TrapClass, 0},			/* RFE */
+    {StoreClass, READS_RS | READS_RT},	/* SB */
+    {StoreClass, READS_RS | READS_RT},	/* SH */
+    {AluClass, READS_RT},		/* SLL */
+    {AluClass, READS_RS | READS_RT},	/* SLLV */
+    {AluClass, READS_RS | READS_RT},	/* SLT */
+    {AluClass, READS_RS},		/* SLTI */
+    {AluClass, READS_RS},		/* SLTIU */
+    {AluClass, READS_RS | READS_RT},	/* SLTU */
+    {AluClass, READS_RT},		/* SRA */
+    {AluClass, READS_RS | READS_RT},	/* SRAV */
+    {AluClass, READS_RT},		/* SRL */
+    {AluClass, READS_RS | READS_RT},	/* SRLV */
+    {AluClass, READS_RS | READS_RT},	/* SUB */
+    {AluClass, READS_RS | READS_RT},	/* SUBU */
+    {StoreClass, READS_RS | READS_RT},	/* SW */
+    {StoreClass, READS_RS | READS_RT},	/* SWL */
+    {StoreClass, READS_RS | READS_RT},	/* SWR */
+    {AluClass, READS_RS | READS_RT},	/* XOR */
+    {AluClass, READS_RS},		/* XORI */
+    {TrapClass, 0},			/* SYSCALL */
+    {TrapClass, 0},			/* UNIMP */
+    {TrapClass, 0}			/* RES */
+};
+
+// How to print each "opCode", for debugging.
+
+OpString opStrings[] = {
+	{"Shouldn't happen", {NONE, NONE, NONE}},
+	{"ADD r%d,r%d,r%d", {RD, RS, RT}},
+	{"ADDI r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"ADDIU r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"ADDU r%d,r%d,r%d", {RD, RS, RT}},
+	{"AND r%d,r%d,r%d", {RD, RS, RT}},
+	{"ANDI r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"BEQ r%d,r%d,%d", {RS, RT, EXTRA}},
+	{"BGEZ r%d,%d", {RS, EXTRA, NONE}},
+	{"BGEZAL r%d,%d", {RS, EXTRA, NONE}},
+	{"BGTZ r%d,%d", {RS, EXTRA, NONE}},
+	{"BLEZ r%d,%d", {RS, EXTRA, NONE}},
+	{"BLTZ r%d,%d", {RS, EXTRA, NONE}},
+	{"BLTZAL r%d,%d", {RS, EXTRA, NONE}},
+	{"BNE r%d,r%d,%d", {RS, RT, EXTRA}},
+	{"Shouldn't happen", {NONE, NONE, NONE}},
+	{"DIV r%d,r%d", {RS, RT, NONE}},
+	{"DIVU r%d,r%d", {RS, RT, NONE}},
+	{"J %d", {EXTRA, NONE, NONE}},
+	{"JAL %d", {EXTRA, NONE, NONE}},
+	{"JALR r%d,r%d", {RD, RS, NONE}},
+	{"JR r%d,r%d", {RD, RS, NONE}},
+	{"LB r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LBU r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LH r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LHU r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LUI r%d,%d", {RT, EXTRA, NONE}},
+	{"LW r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LWL r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LWR r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"Shouldn't happen", {NONE, NONE, NONE}},
+	{"MFHI r%d", {RD, NONE, NONE}},
+	{"MFLO r%d", {RD, NONE, NONE}},
+	{"Shouldn't happen", {NONE, NONE, NONE}},
+	{"MTHI r%d", {RS, NONE, NONE}},
+	{"MTLO r%d", {RS, NONE, NONE}},
+	{"MULT r%d,r%d", {RS, RT, NONE}},
+	{"MULTU r%d,r%d", {RS, RT, NONE}},
+	{"NOR r%d,r%d,r%d", {RD, RS, RT}},
+	{"OR r%d,r%d,r%d", {RD, RS, RT}},
+	{"ORI r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"RFE", {NONE, NONE, NONE}},
+	{"SB r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"SH r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"SLL r%d,r%d,%d", {RD, RT, EXTRA}},
+	{"SLLV r%d,r%d,r%d", {RD, RT, RS}},
+	{"SLT r%d,r%d,r%d", {RD, RS, RT}},
+	{"SLTI r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"SLTIU r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"SLTU r%d,r%d,r%d", {RD, RS, RT}},
+	{"SRA r%d,r%d,%d", {RD, RT, EXTRA}},
+	{"SRAV r%d,r%d,r%d", {RD, RT, RS}},
+	{"SRL r%d,r%d,%d", {RD, RT, EXTRA}},
+	{"SRLV r%d,r%d,r%d", {RD, RT, RS}},
+	{"SUB r%d,r%d,r%d", {RD, RS, RT}},
+	{"SUBU r%d,r%d,r%d", {RD, RS, RT}},
+	{"SW r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"SWL r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"SWR r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"XOR r%d,r%d,r%d", {RD, RS, RT}},
+	{"XORI r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"SYSCALL", {NONE, NONE, NONE}},
+	{"Unimplemented", {NONE, NONE, NONE}},
+	{"Reserved", {NONE, NONE, NONE}}
 };
 
 //----------------------------------------------------------------------
@@ -51,23 +205,55 @@ class Instruction {
 //
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
+//
+//	Each instruction costs one tick, or what the cost model says
+//	(instrTicks), and OneTick has to be called as the last tick of
+//	each one goes by.  But most of the time all it does is advance 
+//	the clock.  So we ask the interrupt simulation how many ticks it 
+//	will be until it has anything else to do (QuietTicks), run 
+//	instructions back to back for that long, and advance the clock 
+//	for all of them at once (SkipTicks).  The instruction during which
+//	something happens gets a real OneTick for its last tick, and so 
+//	does one that traps to the kernel; RaiseException brings the
+//	clock up to date before the kernel gets control.  Timing and
+//	preemption are the same as with a OneTick per tick.
+//
+//	If asked to, we use the basic-block engine instead, except when
+//	single stepping or tracing instructions, address translation or
+//	interrupts, all of which need us to go one tick at a time, or
+//	when there is a TLB, a profile, a cost model or a cache, which
+//	have to see every instruction.
 //----------------------------------------------------------------------
 
 void
 Machine::Run()
 {
-    Instruction *instr = new Instruction;  // storage for decoded instruction
+    int quiet;
 
     if (debug->IsEnabled('m')) {
         cout << "Starting program in thread: " << kernel->currentThread->getName();
 		cout << ", at time: " << kernel->stats->totalTicks << "\n";
     }
     kernel->interrupt->setStatus(UserMode);
+    kernel->currentThread->setUserLevel(TRUE);
+    if (useBlocks && tlb == NULL && opCounts == NULL && costModel == NULL
+		&& icache == NULL && dcache == NULL && trace == NULL && !singleStep && !debug->IsEnabled(dbgMach) 
+		&& !debug->IsEnabled(dbgAddr) && !debug->IsEnabled(dbgInt))
+	RunBlocks();			// never returns
     for (;;) {
-        OneInstruction(instr);
-		kernel->interrupt->OneTick();
-		if (singleStep && (runUntilTime <= kernel->stats->totalTicks))
-	  		Debugger();
+	quiet = singleStep ? 0 : kernel->interrupt->QuietTicks();
+	while (OneInstruction()) {	// if it traps, it still needs
+					// its OneTick
+	    if (ticksOwed + instrTicks > quiet) {
+		kernel->interrupt->SkipTicks(ticksOwed + instrTicks - 1);
+		ticksOwed = 0;
+		break;
+	    }
+	    ticksOwed += instrTicks;
+	}
+	kernel->interrupt->OneTick();
+	if (singleStep && (runUntilTime <= kernel->stats->totalTicks))
+	    Debugger();
     }
 }
 
@@ -99,7 +285,7 @@ TypeToReg(RegType reg, Instruction *instr)
 // 	Execute one instruction from a user-level program
 //
 // 	If there is any kind of exception or interrupt, we invoke the 
-//	exception handler, and when it returns, we return to Run(), which
+//	exception handler, and when it returns, we return FALSE to Run(), which
 //	will re-invoke us in a loop.  This allows us to
 //	re-start the instruction execution from the beginning, in
 //	case any of our state has changed.  On a syscall,
@@ -115,11 +301,21 @@ TypeToReg(RegType reg, Instruction *instr)
 //	leaving.  This allows the Nachos kernel to control our behavior
 //	by controlling the contents of memory, the translation table,
 //	and the register set.
+//
+//	The one exception is the decoded form of each instruction, which
+//	is cached per word of *physical* memory.  The PC is still translated
+//	on every fetch, and the cached copy is thrown away whenever the
+//	word is written (WriteMem) or its frame is handed to a new address
+//	space (InvalidateDecodedPage), so the result is the same as
+//	re-decoding every time.
 //----------------------------------------------------------------------
 
-void
-Machine::OneInstruction(Instruction *instr)
+bool
+Machine::OneInstruction()
 {
+    Instruction *instr;
+    ExceptionType exception;
+    int physAddr;
 #ifdef SIM_FIX
     int byte;       // described in Kane for LWL,LWR,...
 #endif
@@ -129,11 +325,39 @@ Machine::OneInstruction(Instruction *instr)
     int nextLoadValue = 0; 	// record delayed load operation, to apply
 				// in the future
 
-    // Fetch instruction 
-    if (!ReadMem(registers[PCReg], 4, &raw))
-	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
+    // Fetch instruction, decoding it only if this word hasn't been
+    // decoded since it was last written; traced as ReadMem would
+    DEBUG(dbgAddr, "Reading VA " << registers[PCReg] << ", size 4");
+    exception = Translate(registers[PCReg], &physAddr, 4, FALSE);
+    if (exception != NoException) {
+	instrTicks = 1;
+	RaiseException(exception, registers[PCReg]);
+	return FALSE;
+    }
+    instr = &decodeCache[physAddr / 4];
+    if (instr->opCode == OP_NOTDECODED) {
+	raw = *(unsigned int *) &mainMemory[physAddr];
+	instr->value = WordToHost(raw);
+	instr->Decode();
+    }
+    DEBUG(dbgAddr, "\tvalue read = " << (int) instr->value);
+    if (costModel != NULL) {		// charged in full if it traps
+	instrTicks = opTicks[(int) instr->opCode];
+	kernel->stats->numUserInstructions++;
+    } else
+	instrTicks = 1;
+    if (icache != NULL)
+	instrTicks += icache->Access(physAddr, FALSE);
+    if (trace != NULL)
+	trace->Record(TraceFetch, registers[PCReg], physAddr);
+
+    if (opCounts != NULL) {
+	unsigned int word = (unsigned) registers[PCReg] / 4;
+
+	opCounts[(int) instr->opCode]++;
+	if (pcCounts != NULL && word < pcCountsSize)
+	    pcCounts[word]++;
+    }
 
     if (debug->IsEnabled('m')) {
         struct OpString *str = &opStrings[instr->opCode];
@@ -159,7 +383,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = sum;
 	break;
@@ -169,7 +393,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
 	    ((instr->extra ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rt] = sum;
 	break;
@@ -264,7 +488,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_LBU:
 	tmp = registers[instr->rs] + instr->extra;
 	if (!ReadMem(tmp, 1, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x80) && (instr->opCode == OP_LB))
 	    value |= 0xffffff00;
@@ -279,10 +503,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x1) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!ReadMem(tmp, 2, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x8000) && (instr->opCode == OP_LH))
 	    value |= 0xffff0000;
@@ -301,10 +525,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x3) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	nextLoadReg = instr->rt;
 	nextLoadValue = value;
 	break;
@@ -324,7 +548,7 @@ Machine::OneInstruction(Instruction *instr)
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
         if (!ReadMem(tmp-byte, 4, &value))
-            return;
+            return FALSE;
 #else
 	// ReadMem assumes all 4 byte requests are aligned on an even 
 	// word boundary.  Also, the little endian/big endian swap code would
@@ -332,7 +556,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 #endif
 
 	if (registers[LoadReg] == instr->rt)
@@ -376,7 +600,7 @@ Machine::OneInstruction(Instruction *instr)
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
         if (!ReadMem(tmp-byte, 4, &value))
-            return;
+            return FALSE;
 #else
 	// ReadMem assumes all 4 byte requests are aligned on an even 
 	// word boundary.  Also, the little endian/big endian swap code would
@@ -384,7 +608,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 #endif
 
 	if (registers[LoadReg] == instr->rt)
@@ -458,13 +682,13 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SB:
 	if (!WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SH:
 	if (!WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SLL:
@@ -534,7 +758,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = diff;
 	break;
@@ -546,7 +770,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SW:
 	if (!WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SWL:	  
@@ -562,7 +786,7 @@ Machine::OneInstruction(Instruction *instr)
         byte = tmp & 0x3;
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
         if (!ReadMem(tmp-byte, 4, &value))
-            return;
+            return FALSE;
 
         // DEBUG('P', "Value 0x%X\n",value);
 #else
@@ -572,7 +796,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 #endif
 
 #ifdef SIM_FIX
@@ -599,12 +823,12 @@ Machine::OneInstruction(Instruction *instr)
 	}
 #ifndef SIM_FIX
         if (!WriteMem((tmp & ~0x3), 4, value))
-            return;
+            return FALSE;
 #else
         // DEBUG('P', "Value 0x%X\n",value);
 
         if (!WriteMem((tmp - byte), 4, value))
-            return;
+            return FALSE;
 #endif // SIM_FIX
 	break;
     	
@@ -617,7 +841,7 @@ Machine::OneInstruction(Instruction *instr)
         ASSERT((tmp & 0x3) == 0);  
 
         if (!ReadMem((tmp & ~0x3), 4, &value))
-            return;
+            return FALSE;
 #else
         // The only difference between this code and the BIG ENDIAN code
         // is that the ReadMem call is guaranteed an aligned access as 
@@ -630,7 +854,7 @@ Machine::OneInstruction(Instruction *instr)
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
         if (!ReadMem(tmp-byte, 4, &value))
-            return;
+            return FALSE;
         // DEBUG('P', "Value 0x%X\n",value);
 #endif // SIM_FIX
 
@@ -656,12 +880,12 @@ Machine::OneInstruction(Instruction *instr)
 
 #ifndef SIM_FIX
         if (!WriteMem((tmp & ~0x3), 4, value))
-            return;
+            return FALSE;
 #else
         // DEBUG('P', "Value 0x%X\n",value);
 
         if (!WriteMem((tmp - byte), 4, value))
-            return;
+            return FALSE;
 #endif // SIM_FIX
 
 
@@ -669,7 +893,7 @@ Machine::OneInstruction(Instruction *instr)
     	
       case OP_SYSCALL:
 	RaiseException(SyscallException, 0);
-	return; 
+	return FALSE; 
 	
       case OP_XOR:
 	registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
@@ -682,13 +906,16 @@ Machine::OneInstruction(Instruction *instr)
       case OP_RES:
       case OP_UNIMP:
 	RaiseException(IllegalInstrException, 0);
-	return;
+	return FALSE;
 	
       default:
 	ASSERT(FALSE);
     }
     
     // Now we have successfully executed the instruction.
+
+    if (costModel != NULL)
+	ChargeInstruction(instr, pcAfter);
     
     // Do any delayed load operation
     DelayedLoad(nextLoadReg, nextLoadValue);
@@ -698,6 +925,571 @@ Machine::OneInstruction(Instruction *instr)
 						// are jumping into lala-land
     registers[PCReg] = registers[NextPCReg];
     registers[NextPCReg] = pcAfter;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::ChargeInstruction
+// 	Add the cost model's penalties to instrTicks for an instruction
+//	that has just run, before its delayed load (if any) is started:
+//	the load-use penalty if it read the register the previous 
+//	instruction loaded, and the branch penalty if it is a branch or
+//	jump that was taken.
+//
+//	"instr" -- the instruction
+//	"pcAfter" -- where it sends the PC after the delay slot
+//----------------------------------------------------------------------
+
+void
+Machine::ChargeInstruction(Instruction *instr, int pcAfter)
+{
+    int loadReg = registers[LoadReg];
+    int reads = opCostTable[(int) instr->opCode].reads;
+
+    if (costModel->loadUsePenalty > 0 && loadReg != 0
+		&& (((reads & READS_RS) && instr->rs == loadReg)
+		    || ((reads & READS_RT) && instr->rt == loadReg))) {
+	instrTicks += costModel->loadUsePenalty;
+	kernel->stats->numLoadUseStalls++;
+    }
+    if (costModel->branchPenalty > 0 
+		&& pcAfter != registers[NextPCReg] + 4) {
+	instrTicks += costModel->branchPenalty;
+	kernel->stats->numBranchStalls++;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlocks
+// 	Run() for the basic-block engine.  Never returns.
+//
+//	As long as Interrupt::OneTick has nothing to do but advance the
+//	clock (Interrupt::QuietTicks), we run basic blocks, going 
+//	from one instruction to the next with a computed goto, and charge
+//	the clock once per block.  Each instruction does exactly what 
+//	OneInstruction would do with it; the less common ones are simply
+//	handed to OneInstruction.  Anything else -- the instruction on 
+//	which the next event falls, a PC sitting in a branch delay slot,
+//	a fetch that faults -- runs one instruction and one tick at a
+//	time, as in Run().  If only part of a block fits before the next
+//	event, we run that part, and the rest later as a block of its own.
+//
+//	A fused pair (see mipssim.h) runs as the two instructions would,
+//	one after the other; if only the first one fits before the next
+//	event, it runs by itself.
+//
+//	If an instruction traps, RaiseException first charges the ones
+//	before it, and we then call OneTick for the trapping instruction
+//	itself, as Run() would.  We never touch the block again after a
+//	trap, or after a store that threw blocks away, since it may 
+//	have been deleted.
+//----------------------------------------------------------------------
+
+// Finish an instruction the same way OneInstruction does
+#define BlockStep(nextLoadReg, nextLoadValue, nextPC) \
+    { int pcAfter = (nextPC); \
+      registers[registers[LoadReg]] = registers[LoadValueReg]; \
+      registers[LoadReg] = (nextLoadReg); \
+      registers[LoadValueReg] = (nextLoadValue); \
+      registers[0] = 0; \
+      registers[PrevPCReg] = registers[PCReg]; \
+      registers[PCReg] = registers[NextPCReg]; \
+      registers[NextPCReg] = pcAfter; \
+      ticksOwed++; }
+
+// Finish the instruction at "op", and go on to the next one in the block
+#define BlockNext(nextLoadReg, nextLoadValue, nextPC) \
+    { BlockStep(nextLoadReg, nextLoadValue, nextPC); \
+      if (blocksDropped || ++op == end) \
+	  goto blockDone; \
+      goto *op->handler; }
+
+#define BlockSeq(nextLoadReg, nextLoadValue) \
+    BlockNext(nextLoadReg, nextLoadValue, registers[NextPCReg] + 4)
+
+// Start the fused pair at "op", unless its second half is past the end
+#define FusedStart(which) \
+    { if (op + 1 == end) \
+	  goto *op->single; \
+      fusionCounts[which]++; }
+
+// Finish the second instruction of the pair, and go on past it
+#define FusedNext(nextLoadReg, nextLoadValue, nextPC) \
+    { BlockStep(nextLoadReg, nextLoadValue, nextPC); \
+      op += 2; \
+      if (blocksDropped || op == end) \
+	  goto blockDone; \
+      goto *op->handler; }
+
+#define FusedSeq(nextLoadReg, nextLoadValue) \
+    FusedNext(nextLoadReg, nextLoadValue, registers[NextPCReg] + 4)
+
+void
+Machine::RunBlocks()
+{
+    static void *opLabel[MaxOpcode + 1];
+    static void *fuseLabel[NumFusions];
+    Interrupt *interrupt = kernel->interrupt;
+    BasicBlock *block;
+    BlockOp *op, *end;
+    int physAddr, quiet, tmp, value;
+    unsigned int rs, rt, imm;
+
+    if (opLabel[0] == NULL) {
+	for (int i = 0; i <= MaxOpcode; i++)
+	    opLabel[i] = &&other;
+	opLabel[OP_ADDIU] = &&addiu;	opLabel[OP_ADDU] = &&addu;
+	opLabel[OP_SUBU] = &&subu;	opLabel[OP_AND] = &&and_;
+	opLabel[OP_ANDI] = &&andi;	opLabel[OP_OR] = &&or_;
+	opLabel[OP_ORI] = &&ori;	opLabel[OP_XOR] = &&xor_;
+	opLabel[OP_XORI] = &&xori;	opLabel[OP_NOR] = &&nor;
+	opLabel[OP_LUI] = &&lui;	opLabel[OP_SLL] = &&sll;
+	opLabel[OP_SRL] = &&srl;	opLabel[OP_SRA] = &&sra;
+	opLabel[OP_SLLV] = &&sllv;	opLabel[OP_SRLV] = &&srlv;
+	opLabel[OP_SRAV] = &&srav;	opLabel[OP_SLT] = &&slt;
+	opLabel[OP_SLTI] = &&slti;	opLabel[OP_SLTIU] = &&sltiu;
+	opLabel[OP_SLTU] = &&sltu;	opLabel[OP_MFHI] = &&mfhi;
+	opLabel[OP_MFLO] = &&mflo;	opLabel[OP_BEQ] = &&beq;
+	opLabel[OP_BNE] = &&bne;	opLabel[OP_BLEZ] = &&blez;
+	opLabel[OP_BGTZ] = &&bgtz;	opLabel[OP_BLTZ] = &&bltz;
+	opLabel[OP_BGEZ] = &&bgez;	opLabel[OP_J] = &&j;
+	opLabel[OP_JAL] = &&jal;	opLabel[OP_JR] = &&jr;
+	opLabel[OP_JALR] = &&jalr;	opLabel[OP_LW] = &&lw;
+	opLabel[OP_LB] = &&lb;		opLabel[OP_LBU] = &&lbu;
+	opLabel[OP_SW] = &&sw;		opLabel[OP_SB] = &&sb;
+
+	fuseLabel[FuseLuiOri] = &&lui_ori;
+	fuseLabel[FuseLuiAddiu] = &&lui_addiu;
+	fuseLabel[FuseLwAddu] = &&lw_addu;
+	fuseLabel[FuseSltBne] = &&slt_bne;
+	fuseLabel[FuseSltBeq] = &&slt_beq;
+	fuseLabel[FuseAddiuSw] = &&addiu_sw;
+	fuseLabel[FuseLwAddiu] = &&lw_addiu;
+    }
+
+    quiet = interrupt->QuietTicks();
+    for (;;) {
+	block = NULL;
+	if (registers[NextPCReg] == registers[PCReg] + 4 &&
+	    Translate(registers[PCReg], &physAddr, 4, FALSE) == NoException) {
+	    block = blockCache[physAddr / 4];
+	    if (block == NULL)
+		block = BuildBlock(physAddr, opLabel, fuseLabel);
+	}
+	if (block == NULL || quiet == 0) {
+	    OneInstruction();
+	    interrupt->OneTick();
+	    quiet = interrupt->QuietTicks();
+	    continue;
+	}
+
+	op = block->ops;
+	end = op + min(block->length, quiet);
+	blocksDropped = FALSE;
+	goto *op->handler;
+
+      addiu:
+	registers[op->rt] = registers[op->rs] + op->extra;
+	BlockSeq(0, 0);
+      addu:
+	registers[op->rd] = registers[op->rs] + registers[op->rt];
+	BlockSeq(0, 0);
+      subu:
+	registers[op->rd] = registers[op->rs] - registers[op->rt];
+	BlockSeq(0, 0);
+      and_:
+	registers[op->rd] = registers[op->rs] & registers[op->rt];
+	BlockSeq(0, 0);
+      andi:
+	registers[op->rt] = registers[op->rs] & (op->extra & 0xffff);
+	BlockSeq(0, 0);
+      or_:
+	registers[op->rd] = registers[op->rs] | registers[op->rt];
+	BlockSeq(0, 0);
+      ori:
+	registers[op->rt] = registers[op->rs] | (op->extra & 0xffff);
+	BlockSeq(0, 0);
+      xor_:
+	registers[op->rd] = registers[op->rs] ^ registers[op->rt];
+	BlockSeq(0, 0);
+      xori:
+	registers[op->rt] = registers[op->rs] ^ (op->extra & 0xffff);
+	BlockSeq(0, 0);
+      nor:
+	registers[op->rd] = ~(registers[op->rs] | registers[op->rt]);
+	BlockSeq(0, 0);
+      lui:
+	registers[op->rt] = op->extra << 16;
+	BlockSeq(0, 0);
+      sll:
+	registers[op->rd] = registers[op->rt] << op->extra;
+	BlockSeq(0, 0);
+      srl:
+	tmp = registers[op->rt];
+	tmp >>= op->extra;
+	registers[op->rd] = tmp;
+	BlockSeq(0, 0);
+      sra:
+	registers[op->rd] = registers[op->rt] >> op->extra;
+	BlockSeq(0, 0);
+      sllv:
+	registers[op->rd] = registers[op->rt] << (registers[op->rs] & 0x1f);
+	BlockSeq(0, 0);
+      srlv:
+	tmp = registers[op->rt];
+	tmp >>= (registers[op->rs] & 0x1f);
+	registers[op->rd] = tmp;
+	BlockSeq(0, 0);
+      srav:
+	registers[op->rd] = registers[op->rt] >> (registers[op->rs] & 0x1f);
+	BlockSeq(0, 0);
+      slt:
+	registers[op->rd] = (registers[op->rs] < registers[op->rt]) ? 1 : 0;
+	BlockSeq(0, 0);
+      slti:
+	registers[op->rt] = (registers[op->rs] < op->extra) ? 1 : 0;
+	BlockSeq(0, 0);
+      sltiu:
+	rs = registers[op->rs];
+	imm = op->extra;
+	registers[op->rt] = (rs < imm) ? 1 : 0;
+	BlockSeq(0, 0);
+      sltu:
+	rs = registers[op->rs];
+	rt = registers[op->rt];
+	registers[op->rd] = (rs < rt) ? 1 : 0;
+	BlockSeq(0, 0);
+      mfhi:
+	registers[op->rd] = registers[HiReg];
+	BlockSeq(0, 0);
+      mflo:
+	registers[op->rd] = registers[LoReg];
+	BlockSeq(0, 0);
+
+      beq:
+	BlockNext(0, 0, (registers[op->rs] == registers[op->rt]) ?
+		registers[NextPCReg] + IndexToAddr(op->extra) :
+		registers[NextPCReg] + 4);
+      bne:
+	BlockNext(0, 0, (registers[op->rs] != registers[op->rt]) ?
+		registers[NextPCReg] + IndexToAddr(op->extra) :
+		registers[NextPCReg] + 4);
+      blez:
+	BlockNext(0, 0, (registers[op->rs] <= 0) ?
+		registers[NextPCReg] + IndexToAddr(op->extra) :
+		registers[NextPCReg] + 4);
+      bgtz:
+	BlockNext(0, 0, (registers[op->rs] > 0) ?
+		registers[NextPCReg] + IndexToAddr(op->extra) :
+		registers[NextPCReg] + 4);
+      bltz:
+	BlockNext(0, 0, (registers[op->rs] & SIGN_BIT) ?
+		registers[NextPCReg] + IndexToAddr(op->extra) :
+		registers[NextPCReg] + 4);
+      bgez:
+	BlockNext(0, 0, !(registers[op->rs] & SIGN_BIT) ?
+		registers[NextPCReg] + IndexToAddr(op->extra) :
+		registers[NextPCReg] + 4);
+      j:
+	BlockNext(0, 0, ((registers[NextPCReg] + 4) & 0xf0000000) |
+		IndexToAddr(op->extra));
+      jal:
+	registers[R31] = registers[NextPCReg] + 4;
+	BlockNext(0, 0, ((registers[NextPCReg] + 4) & 0xf0000000) |
+		IndexToAddr(op->extra));
+      jr:
+	BlockNext(0, 0, registers[op->rs]);
+      jalr:
+	registers[op->rd] = registers[NextPCReg] + 4;
+	BlockNext(0, 0, registers[op->rs]);
+
+      lw:
+	tmp = registers[op->rs] + op->extra;
+	if (tmp & 0x3) {
+	    RaiseException(AddressErrorException, tmp);
+	    goto trapped;
+	}
+	if (!ReadMem(tmp, 4, &value))
+	    goto trapped;
+	BlockSeq(op->rt, value);
+      lb:
+	if (!ReadMem(registers[op->rs] + op->extra, 1, &value))
+	    goto trapped;
+	BlockSeq(op->rt, (value & 0x80) ? (value | 0xffffff00) : (value & 0xff));
+      lbu:
+	if (!ReadMem(registers[op->rs] + op->extra, 1, &value))
+	    goto trapped;
+	BlockSeq(op->rt, value & 0xff);
+      sw:
+	if (!WriteMem((unsigned) (registers[op->rs] + op->extra), 4,
+		      registers[op->rt]))
+	    goto trapped;
+	BlockSeq(0, 0);
+      sb:
+	if (!WriteMem((unsigned) (registers[op->rs] + op->extra), 1,
+		      registers[op->rt]))
+	    goto trapped;
+	BlockSeq(0, 0);
+
+      // the fused pairs: the first instruction is at op, the second
+      // at op + 1
+      lui_ori:
+	FusedStart(FuseLuiOri);
+	registers[op->rt] = op->extra << 16;
+	BlockStep(0, 0, registers[NextPCReg] + 4);
+	registers[op[1].rt] = registers[op[1].rs] | (op[1].extra & 0xffff);
+	FusedSeq(0, 0);
+      lui_addiu:
+	FusedStart(FuseLuiAddiu);
+	registers[op->rt] = op->extra << 16;
+	BlockStep(0, 0, registers[NextPCReg] + 4);
+	registers[op[1].rt] = registers[op[1].rs] + op[1].extra;
+	FusedSeq(0, 0);
+      lw_addu:
+	FusedStart(FuseLwAddu);
+	tmp = registers[op->rs] + op->extra;
+	if (tmp & 0x3) {
+	    RaiseException(AddressErrorException, tmp);
+	    goto trapped;
+	}
+	if (!ReadMem(tmp, 4, &value))
+	    goto trapped;
+	BlockStep(op->rt, value, registers[NextPCReg] + 4);
+	registers[op[1].rd] = registers[op[1].rs] + registers[op[1].rt];
+	FusedSeq(0, 0);
+      slt_bne:
+	FusedStart(FuseSltBne);
+	registers[op->rd] = (registers[op->rs] < registers[op->rt]) ? 1 : 0;
+	BlockStep(0, 0, registers[NextPCReg] + 4);
+	FusedNext(0, 0, (registers[op[1].rs] != registers[op[1].rt]) ?
+		registers[NextPCReg] + IndexToAddr(op[1].extra) :
+		registers[NextPCReg] + 4);
+      slt_beq:
+	FusedStart(FuseSltBeq);
+	registers[op->rd] = (registers[op->rs] < registers[op->rt]) ? 1 : 0;
+	BlockStep(0, 0, registers[NextPCReg] + 4);
+	FusedNext(0, 0, (registers[op[1].rs] == registers[op[1].rt]) ?
+		registers[NextPCReg] + IndexToAddr(op[1].extra) :
+		registers[NextPCReg] + 4);
+      addiu_sw:
+	FusedStart(FuseAddiuSw);
+	registers[op->rt] = registers[op->rs] + op->extra;
+	BlockStep(0, 0, registers[NextPCReg] + 4);
+	if (!WriteMem((unsigned) (registers[op[1].rs] + op[1].extra), 4,
+		      registers[op[1].rt]))
+	    goto trapped;
+	FusedSeq(0, 0);
+      lw_addiu:
+	FusedStart(FuseLwAddiu);
+	tmp = registers[op->rs] + op->extra;
+	if (tmp & 0x3) {
+	    RaiseException(AddressErrorException, tmp);
+	    goto trapped;
+	}
+	if (!ReadMem(tmp, 4, &value))
+	    goto trapped;
+	BlockStep(op->rt, value, registers[NextPCReg] + 4);
+	registers[op[1].rt] = registers[op[1].rs] + op[1].extra;
+	FusedSeq(0, 0);
+
+      other:
+	if (!OneInstruction())
+	    goto trapped;
+	ticksOwed++;
+	if (blocksDropped || ++op == end)
+	    goto blockDone;
+	goto *op->handler;
+
+      trapped:
+	interrupt->OneTick();
+	quiet = interrupt->QuietTicks();
+	continue;
+
+      blockDone:
+	interrupt->SkipTicks(ticksOwed);
+	quiet -= ticksOwed;
+	ticksOwed = 0;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::BuildBlock
+// 	Make the basic block that starts at physical address "physAddr",
+//	and enter it in blockCache.  The block stops at the end of the 
+//	page, after the delay slot of a branch or jump, or after an 
+//	instruction that always traps.
+//
+//	Adjacent pairs of instructions that RunBlocks can run as one
+//	(see fusionPairs) are given the fused handler.
+//
+//	"physAddr" -- the (word aligned) physical address of the block
+//	"opLabel" -- where RunBlocks executes each kind of instruction
+//	"fuseLabel" -- where it executes each kind of fused pair
+//----------------------------------------------------------------------
+
+// The pairs of instructions that are fused, in the order of the Fusion
+// enum.
+
+static struct {
+    char first, second;			// their opcodes
+    char *name;
+} fusionPairs[NumFusions] = {
+    { OP_LUI,	OP_ORI,		"lui+ori" },
+    { OP_LUI,	OP_ADDIU,	"lui+addiu" },
+    { OP_LW,	OP_ADDU,	"lw+addu" },
+    { OP_SLT,	OP_BNE,		"slt+bne" },
+    { OP_SLT,	OP_BEQ,		"slt+beq" },
+    { OP_ADDIU,	OP_SW,		"addiu+sw" },
+    { OP_LW,	OP_ADDIU,	"lw+addiu" },
+};
+
+BasicBlock *
+Machine::BuildBlock(int physAddr, void **opLabel, void **fuseLabel)
+{
+    int first = physAddr / 4;
+    int pageEnd = (physAddr / PageSize + 1) * PageSize / 4;
+    int length = 0;
+    bool delaySlot = FALSE, stop = FALSE;
+    Instruction *instr;
+    BasicBlock *block;
+
+    while (!stop && first + length < pageEnd) {
+	instr = &decodeCache[first + length];
+	if (instr->opCode == OP_NOTDECODED) {
+	    instr->value = WordToHost(*(unsigned int *) 
+				&mainMemory[(first + length) * 4]);
+	    instr->Decode();
+	}
+	length++;
+	stop = delaySlot;
+	switch (instr->opCode) {
+	  case OP_BEQ: case OP_BNE: case OP_BLEZ: case OP_BGTZ:
+	  case OP_BLTZ: case OP_BGEZ: case OP_BLTZAL: case OP_BGEZAL:
+	  case OP_J: case OP_JAL: case OP_JR: case OP_JALR:
+	    delaySlot = TRUE;
+	    break;
+	  case OP_SYSCALL: case OP_RES: case OP_UNIMP:
+	    stop = TRUE;
+	    break;
+	}
+    }
+
+    block = new BasicBlock(first, length);
+    for (int i = 0; i < length; i++) {
+	instr = &decodeCache[first + i];
+	block->ops[i].handler = opLabel[(int) instr->opCode];
+	block->ops[i].extra = instr->extra;
+	block->ops[i].rs = instr->rs;
+	block->ops[i].rt = instr->rt;
+	block->ops[i].rd = instr->rd;
+    }
+    for (int i = 0; i + 1 < length; i++) {
+	for (int f = 0; f < NumFusions; f++) {
+	    if (decodeCache[first + i].opCode == fusionPairs[f].first &&
+		decodeCache[first + i + 1].opCode == fusionPairs[f].second) {
+		block->ops[i].single = block->ops[i].handler;
+		block->ops[i].handler = fuseLabel[f];
+		i++;			// the second can't start a pair
+		break;
+	    }
+	}
+    }
+    blockCache[first] = block;
+    blocksInPage[physAddr / PageSize]++;
+    return block;
+}
+
+//----------------------------------------------------------------------
+// Machine::DropBlocks
+// 	Throw away every basic block that holds any of the "size" bytes
+//	of mainMemory starting at "physAddr", which must all be in one 
+//	page, because they have been overwritten.
+//----------------------------------------------------------------------
+
+void
+Machine::DropBlocks(int physAddr, int size)
+{
+    int page = physAddr / PageSize;
+    BasicBlock **entry = &blockCache[page * PageSize / 4];
+
+    for (int i = 0; i < PageSize / 4 && blocksInPage[page] > 0; i++) {
+	if (entry[i] != NULL && entry[i]->first * 4 < physAddr + size
+		&& (entry[i]->first + entry[i]->length) * 4 > physAddr) {
+	    delete entry[i];
+	    entry[i] = NULL;
+	    blocksInPage[page]--;
+	    blocksDropped = TRUE;
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::PrintProfile
+// 	Print how many instructions of each kind have been run, most 
+//	common first.  The PC histograms are printed by the address spaces
+//	that own them.
+//----------------------------------------------------------------------
+
+static int *sortCounts;		// what CompareOpcodes sorts by
+
+static int
+CompareOpcodes(const void *a, const void *b)
+{
+    int x = *(int *) a, y = *(int *) b;
+
+    if (sortCounts[x] != sortCounts[y])
+	return sortCounts[y] - sortCounts[x];
+    return x - y;			// ties in address order
+}
+
+void
+Machine::PrintProfile()
+{
+    int order[MaxOpcode + 1];
+    int i, total = 0;
+    char name[16], buf[80];
+
+    ASSERT(opCounts != NULL);
+    for (i = 0; i <= MaxOpcode; i++) {
+	order[i] = i;
+	total += opCounts[i];
+    }
+    sortCounts = opCounts;
+    qsort(order, MaxOpcode + 1, sizeof(int), CompareOpcodes);
+
+    cout << "Instruction profile: " << total << " instructions\n";
+    for (i = 0; i <= MaxOpcode && opCounts[order[i]] > 0; i++) {
+	sscanf(opStrings[order[i]].format, "%15s", name);
+	sprintf(buf, "  %-8s %10d  %5.1f%%", name, opCounts[order[i]],
+				100.0 * opCounts[order[i]] / total);
+	cout << buf << "\n";
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::PrintFusions
+// 	Print how many times each pair of instructions was run fused by
+//	the basic-block engine, most common first.
+//----------------------------------------------------------------------
+
+void
+Machine::PrintFusions()
+{
+    int order[NumFusions];
+    int i;
+    char buf[80];
+
+    for (i = 0; i < NumFusions; i++)
+	order[i] = i;
+    sortCounts = fusionCounts;
+    qsort(order, NumFusions, sizeof(int), CompareOpcodes);
+
+    cout << "Fused instruction pairs:\n";
+    for (i = 0; i < NumFusions; i++) {
+	sprintf(buf, "  %-10s %10d", fusionPairs[order[i]].name, 
+				fusionCounts[order[i]]);
+	cout << buf << "\n";
+    }
 }
 
 //----------------------------------------------------------------------
@@ -725,7 +1517,7 @@ Machine::DelayedLoad(int nextReg, int nextValue)
 void
 Instruction::Decode()
 {
-    OpInfo *opPtr;
+    const OpInfo *opPtr;
     
     rs = (value >> 21) & 0x1f;
     rt = (value >> 16) & 0x1f;
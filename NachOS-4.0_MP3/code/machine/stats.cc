@@ -10,6 +10,39 @@
 #include "copyright.h"
 #include "debug.h"
 #include "stats.h"
+#include "cache.h"
+#include "trace.h"
+
+// The cost models to choose from.  "flat" is the classic charge, one
+// tick per instruction, but with the instructions counted.  "r3000" 
+// hides load and branch latency behind the delay slots, as the real
+// R3000 does, and only charges extra for the multiply/divide unit. 
+// "r4000" models the deeper pipeline: two cycles of load latency and
+// three of branch latency beyond the delay slot, and its slower divide.
+
+static CostModel costModels[] = {
+//	   name	    alu load store branch jump mult div trap  load-use branch
+    { "flat",	  { 1,  1,   1,    1,     1,    1,   1,  1 },	0,	0 },
+    { "r3000",	  { 1,  1,   1,    1,     1,   12,  35,  1 },	0,	0 },
+    { "r4000",	  { 1,  1,   1,    1,     1,   10,  69,  1 },	2,	3 },
+};
+
+static char *instrClassNames[] = { "alu", "load", "store", "branch", 
+				"jump", "mult", "div", "trap" };
+
+//----------------------------------------------------------------------
+// FindCostModel
+// 	Return the cost model called "name", or NULL if there isn't one.
+//----------------------------------------------------------------------
+
+CostModel *
+FindCostModel(char *name)
+{
+    for (unsigned int i = 0; i < sizeof(costModels) / sizeof(CostModel); i++)
+	if (strcmp(costModels[i].name, name) == 0)
+	    return &costModels[i];
+    return NULL;
+}
 
 //----------------------------------------------------------------------
 // Statistics::Statistics
@@ -22,6 +55,96 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numStealRequests = numMigrations = 0;
+    numPeriods = numDeadlineMisses = numOverruns = 0;
+    numFullSwitches = numLightSwitches = 0;
+    printSwitches = FALSE;
+    numTLBHits = numTLBMisses = 0;
+    costModel = NULL;
+    numUserInstructions = numLoadUseStalls = numBranchStalls = 0;
+    icache = dcache = NULL;
+    trace = NULL;
+    firstThread = lastThread = NULL;
+    printThreads = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Statistics::Accumulate
+// 	Add the metrics another copy of Nachos collected into these (see
+//	Kernel::StartProcesses).  The copies run side by side, so the total
+//	time is that of the one that ran longest; everything else adds up.
+//	The caches keep their own counts, which are added separately.
+//
+//	"other" -- the statistics of the other copy
+//----------------------------------------------------------------------
+
+void
+Statistics::Accumulate(Statistics *other)
+{
+    if (other->totalTicks > totalTicks)
+	totalTicks = other->totalTicks;
+    idleTicks += other->idleTicks;
+    systemTicks += other->systemTicks;
+    userTicks += other->userTicks;
+    numDiskReads += other->numDiskReads;
+    numDiskWrites += other->numDiskWrites;
+    numConsoleCharsRead += other->numConsoleCharsRead;
+    numConsoleCharsWritten += other->numConsoleCharsWritten;
+    numPageFaults += other->numPageFaults;
+    numTLBHits += other->numTLBHits;
+    numTLBMisses += other->numTLBMisses;
+    numPacketsSent += other->numPacketsSent;
+    numPacketsRecvd += other->numPacketsRecvd;
+    numStealRequests += other->numStealRequests;
+    numMigrations += other->numMigrations;
+    numPeriods += other->numPeriods;
+    numDeadlineMisses += other->numDeadlineMisses;
+    numOverruns += other->numOverruns;
+    numFullSwitches += other->numFullSwitches;
+    numLightSwitches += other->numLightSwitches;
+    numUserInstructions += other->numUserInstructions;
+    numLoadUseStalls += other->numLoadUseStalls;
+    numBranchStalls += other->numBranchStalls;
+}
+
+//----------------------------------------------------------------------
+// Statistics::AddThread
+// 	Start counting what a new thread uses.  The counts are kept
+//	after it finishes, to be printed when Nachos halts.
+//
+//	"threadID", "threadName" -- which thread it is
+//----------------------------------------------------------------------
+
+ThreadStatistics *
+Statistics::AddThread(int threadID, char *threadName)
+{
+    ThreadStatistics *thread = new ThreadStatistics(threadID, threadName);
+
+    if (firstThread == NULL)
+	firstThread = thread;
+    else
+	lastThread->next = thread;
+    lastThread = thread;
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// Statistics::FindThread
+// 	Return what the thread with this ID has used -- if there has been
+//	more than one, the last -- or NULL if there has been none.
+//
+//	"threadID" -- which thread
+//----------------------------------------------------------------------
+
+ThreadStatistics *
+Statistics::FindThread(int threadID)
+{
+    ThreadStatistics *found = NULL;
+
+    for (ThreadStatistics *t = firstThread; t != NULL; t = t->next)
+	if (t->id == threadID)
+	    found = t;
+    return found;
 }
 
 //----------------------------------------------------------------------
@@ -40,6 +163,84 @@ Statistics::Print()
 		cout << "Console I/O: reads " << numConsoleCharsRead;
     cout << ", writes " << numConsoleCharsWritten << "\n";
     cout << "Paging: faults " << numPageFaults << "\n";
+    if (numTLBHits + numTLBMisses > 0) {
+	cout << "TLB: hits " << numTLBHits << ", misses " << numTLBMisses;
+	cout << ", hit ratio " << 
+		(100.0 * numTLBHits) / (numTLBHits + numTLBMisses) << "%\n";
+    }
+    if (costModel != NULL) {
+	cout << "Cost model " << costModel->name << ":";
+	for (int i = 0; i < NumInstrClasses; i++)
+	    cout << " " << instrClassNames[i] << " " << 
+			costModel->classTicks[i];
+	cout << ", load-use +" << costModel->loadUsePenalty;
+	cout << ", taken branch +" << costModel->branchPenalty << "\n";
+	cout << "User instructions: " << numUserInstructions;
+	if (numUserInstructions > 0)
+	    cout << ", ticks per instruction " << 
+		(double) userTicks / numUserInstructions;
+	cout << "\nStalls: load-use " << numLoadUseStalls;
+	cout << ", branch " << numBranchStalls << "\n";
+    }
+    if (icache != NULL)
+	icache->Print();
+    if (dcache != NULL)
+	dcache->Print();
+    if (trace != NULL)
+	trace->Print();
+    if (numStealRequests > 0) {
+	cout << "Load balancing: requests for work " << numStealRequests;
+	cout << ", programs migrated " << numMigrations << "\n";
+    }
+    if (numPeriods > 0) {
+	cout << "Real-time: periods " << numPeriods;
+	cout << ", deadlines missed " << numDeadlineMisses;
+	cout << ", budgets overrun " << numOverruns << "\n";
+    }
+    if (printSwitches) {
+	cout << "Context switches: full " << numFullSwitches;
+	cout << ", light " << numLightSwitches << "\n";
+    }
     cout << "Network I/O: packets received " << numPacketsRecvd;
 		cout << ", sent " << numPacketsSent << "\n";
+    if (printThreads) {
+	for (ThreadStatistics *t = firstThread; t != NULL; t = t->next)
+	    t->Print();
+    }
+}
+
+//----------------------------------------------------------------------
+// ThreadStatistics::ThreadStatistics
+// 	Initialize what a new thread has used to zero.
+//
+//	"threadID", "threadName" -- which thread it is
+//----------------------------------------------------------------------
+
+ThreadStatistics::ThreadStatistics(int threadID, char *threadName)
+{
+    id = threadID;
+    name = threadName;
+    userTicks = systemTicks = readyTicks = readySince = lockTicks = 0;
+    numVoluntarySwitches = numInvoluntarySwitches = 0;
+    numPageFaults = numDiskReads = numDiskWrites = 0;
+    numConsoleCharsRead = numConsoleCharsWritten = 0;
+    next = NULL;
+}
+
+//----------------------------------------------------------------------
+// ThreadStatistics::Print
+// 	Print what one thread has used, when Nachos halts.
+//----------------------------------------------------------------------
+
+void
+ThreadStatistics::Print()
+{
+    cout << "Thread " << id << " (" << name << "): ticks user " 
+	 << userTicks << ", system " << systemTicks << ", ready " 
+	 << readyTicks << ", lock wait " << lockTicks << "; switches voluntary " << numVoluntarySwitches
+	 << ", involuntary " << numInvoluntarySwitches << "\n";
+    cout << "    page faults " << numPageFaults << "; disk reads " 
+	 << numDiskReads << ", writes " << numDiskWrites 
+	 << "; console reads " << numConsoleCharsRead << ", writes " 
+	 << numConsoleCharsWritten << "\n";
 }
@@ -13,6 +13,41 @@
 
 #include "copyright.h"
 
+class CostModel;
+class Cache;
+class Trace;
+
+// The following class defines what one thread has used, so that we can
+// tell which user program is responsible for what: each program has a
+// thread of its own.  Statistics keeps one for every thread there has
+// been, finished or not.
+
+class ThreadStatistics {
+  public:
+    int id;			// the thread's ID and name
+    char *name;
+    int userTicks;		// Time it spent executing user code,
+    int systemTicks;		// and system code on its behalf
+    int readyTicks;		// Time it spent waiting in a ready queue
+    int readySince;		// when it last joined one
+    int lockTicks;		// Time it spent waiting to acquire locks
+    int numVoluntarySwitches;	// times it gave up the CPU to wait, or
+				// because it was finished
+    int numInvoluntarySwitches;	// times it gave up the CPU still ready
+				// to run (preempted, or it yielded)
+    int numPageFaults;		// page faults it took (not counting TLB
+				// misses the page table could refill)
+    int numDiskReads;		// disk sectors it read
+    int numDiskWrites;		// and wrote
+    int numConsoleCharsRead;	// characters it read from the keyboard
+    int numConsoleCharsWritten; // and wrote to the display
+    ThreadStatistics *next;	// the next thread's, in order of creation
+
+    ThreadStatistics(int threadID, char *threadName);
+				// initialize everything to zero
+    void Print();		// print what the thread has used
+};
+
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
 // many user instructions executed, etc.
@@ -25,19 +60,54 @@ class Statistics {
     int idleTicks;       	// Time spent idle (no threads to run)
     int systemTicks;	 	// Time spent executing system code
     int userTicks;       	// Time spent executing user code
-				// (this is also equal to # of
-				// user instructions executed)
+				// (with no cost model, this is also
+				// equal to # of user instructions
+				// executed)
 
     int numDiskReads;		// number of disk read requests
     int numDiskWrites;		// number of disk write requests
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numTLBHits;		// number of translations found in the TLB
+    int numTLBMisses;		// number of translations not in the TLB
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int numStealRequests;	// times this copy ran out of work and asked
+				// the others for some (-procs)
+    int numMigrations;		// programs moved to this copy from another
+    int numPeriods;		// periods of real-time threads ended
+    int numDeadlineMisses;	// ones that ended with the thread still
+				// wanting the CPU
+    int numOverruns;		// times a real-time thread used up its
+				// budget
+    int numFullSwitches;	// context switches that loaded another
+				// address space
+    int numLightSwitches;	// ones that kept the one loaded
+    bool printSwitches;		// print those two counts (-cs)
+
+    CostModel *costModel;	// what user instructions are charged, or
+				// NULL for UserTick apiece
+    int numUserInstructions;	// user instructions executed, and the
+    int numLoadUseStalls;	// ones charged extra by the cost model
+    int numBranchStalls;	// (only counted with a cost model)
+    Cache *icache;		// the instruction and data caches, if
+    Cache *dcache;		// any; they count their own hits and
+				// misses
+    Trace *trace;		// the trace being recorded or played
+				// back, if any; it counts its records
+    ThreadStatistics *firstThread;	// what each thread has used, in
+    ThreadStatistics *lastThread;	// order of creation
+    bool printThreads;		// print that too (-usage)
 
     Statistics(); 		// initialize everything to zero
 
+    void Accumulate(Statistics *other);
+				// add in what another copy collected
+    ThreadStatistics *AddThread(int threadID, char *threadName);
+				// start counting for a new thread
+    ThreadStatistics *FindThread(int threadID);
+				// the last thread with this ID, or NULL
     void Print();		// print collected statistics
 };
 
@@ -49,14 +119,40 @@ class Statistics {
 // in the kernel measured by the number of calls to enable interrupts,
 // these time constants are none too exact.
 
-const int UserTick = 	   1;	// advance for each user-level instruction 
+const int UserTick = 	   1;	// advance for each user-level instruction
+				// (unless a CostModel says otherwise)
 const int SystemTick =	  10; 	// advance each time interrupts are enabled
 const int RotationTime = 500; 	// time disk takes to rotate one sector
 const int SeekTime =	 500;  	// time disk takes to seek past one track
 const int ConsoleTime =	 100;	// time to read or write one character
 const int NetworkTime =	 100;  	// time to send or receive one packet
+const int MemoryTime =	  10;	// time to fill or write back one cache line
 
 //MP3: RR time quantum: 100(count in userticks) = 110 - 10(system interrupt time)
 const int TimerTicks = 	 110;  	// (average) time between timer interrupts
 
+// A cost model charges each user instruction according to its class,
+// instead of a flat UserTick, plus a penalty when it uses the register
+// loaded by the instruction just before it, or when it is a taken 
+// branch or jump.  The costs are in units of UserTick.  Select one at
+// startup with -cost (see Kernel); the machine picks each instruction's
+// class from its opcode (see mipssim.h).
+
+enum InstrClass { AluClass, LoadClass, StoreClass, BranchClass, JumpClass,
+		  MultClass, DivClass, TrapClass,
+		  
+		  NumInstrClasses
+};
+
+class CostModel {
+  public:
+    char *name;
+    int classTicks[NumInstrClasses];	// cost of each class of instruction
+    int loadUsePenalty;		// extra for reading a register the 
+				// previous instruction loaded
+    int branchPenalty;		// extra for a taken branch or jump
+};
+
+CostModel *FindCostModel(char *name);	// the model called "name", or NULL
+
 #endif // STATS_H
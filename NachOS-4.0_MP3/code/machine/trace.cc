@@ -0,0 +1,178 @@
+// trace.cc
+//	Routines to record a trace of a user program, and to play it
+//	back through the TLB and cache models.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "debug.h"
+#include "trace.h"
+#include "machine.h"
+#include "cache.h"
+#include "main.h"
+
+static char *traceEventNames[] = { "fetch", "load", "store", "syscall",
+				   "fault", "interrupt", "space" };
+
+//----------------------------------------------------------------------
+// Trace::Trace
+// 	Open a trace file.
+//
+//	"fileName" -- the UNIX file to hold the trace
+//	"recording" -- TRUE to write a new trace, FALSE to play one back
+//----------------------------------------------------------------------
+
+Trace::Trace(char *fileName, bool recording)
+{
+    name = fileName;
+    writing = recording;
+    if (writing)
+	fd = OpenForWrite(fileName);
+    else
+	fd = OpenForReadWrite(fileName, TRUE);
+    buffer = new char[TraceBufferSize];
+    used = filled = 0;
+    for (int i = 0; i < NumTraceEvents; i++)
+	count[i] = 0;
+}
+
+//----------------------------------------------------------------------
+// Trace::~Trace
+// 	Close the trace file, after writing out any records still in
+//	the buffer.
+//----------------------------------------------------------------------
+
+Trace::~Trace()
+{
+    if (writing && used > 0)
+	WriteFile(fd, buffer, used);
+    Close(fd);
+    delete [] buffer;
+}
+
+//----------------------------------------------------------------------
+// Trace::Record
+// 	Add a record to the trace, writing the buffer out when it fills.
+//
+//	"event" -- what happened
+//	"first", "second" -- what it happened to (see TraceEvent)
+//----------------------------------------------------------------------
+
+void
+Trace::Record(TraceEvent event, int first, int second)
+{
+    ASSERT(writing);
+    if (used == TraceBufferSize) {
+	WriteFile(fd, buffer, used);
+	used = 0;
+    }
+    buffer[used] = (char) event;
+    bcopy(&first, &buffer[used + 1], sizeof(int));
+    bcopy(&second, &buffer[used + 1 + sizeof(int)], sizeof(int));
+    used += TraceRecordSize;
+    count[event]++;
+}
+
+//----------------------------------------------------------------------
+// Trace::Next
+// 	Read the next record of the trace, refilling the buffer from the
+//	file when it runs out.  Return FALSE at the end of the trace.
+//
+//	"event" -- set to what happened
+//	"first", "second" -- set to what it happened to
+//----------------------------------------------------------------------
+
+bool
+Trace::Next(TraceEvent *event, int *first, int *second)
+{
+    ASSERT(!writing);
+    if (used + TraceRecordSize > filled) {
+	int left = filled - used;		// a partial record
+
+	bcopy(&buffer[used], buffer, left);
+	filled = left + ReadPartial(fd, &buffer[left], TraceBufferSize - left);
+	used = 0;
+	if (filled < TraceRecordSize)
+	    return FALSE;
+    }
+    *event = (TraceEvent) buffer[used];
+    ASSERT(*event >= 0 && *event < NumTraceEvents);
+    bcopy(&buffer[used + 1], first, sizeof(int));
+    bcopy(&buffer[used + 1 + sizeof(int)], second, sizeof(int));
+    used += TraceRecordSize;
+    count[*event]++;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Trace::Print
+// 	Print how many records of each kind were recorded or played back.
+//----------------------------------------------------------------------
+
+void
+Trace::Print()
+{
+    cout << "Trace " << name << ":";
+    for (int i = 0; i < NumTraceEvents; i++)
+	cout << " " << traceEventNames[i] << " " << count[i];
+    cout << "\n";
+}
+
+//----------------------------------------------------------------------
+// Machine::Replay
+// 	Play back a trace recorded by some earlier run, through this
+//	machine's TLB and caches, instead of running a program.  Every
+//	fetch, load and store looks up the TLB (if there is one) and then
+//	the instruction or data cache (if there is one), just as it did
+//	when the trace was recorded; a TLB miss loads the translation the
+//	trace says was used.  The hits and misses are counted as usual.
+//	Nothing else is simulated: memory holds nothing, the clock doesn't
+//	move, and system calls and interrupts are only counted.
+//
+//	Returns the extra ticks the cache misses would have cost.
+//
+//	"from" -- the trace to play back
+//----------------------------------------------------------------------
+
+int
+Machine::Replay(Trace *from)
+{
+    TraceEvent event;
+    int virtAddr, physAddr, ignored, stallTicks = 0;
+    bool writing;
+    Cache *cache;
+    TranslationEntry *entry;
+
+    while (from->Next(&event, &virtAddr, &physAddr)) {
+	switch (event) {
+	  case TraceFetch:
+	  case TraceLoad:
+	  case TraceStore:
+	    writing = (event == TraceStore);
+	    if (tlb != NULL && 
+		    Translate(virtAddr, &ignored, 1, writing) == PageFaultException) {
+		entry = &tlb[TLBVictim()];	// a TLB miss: refill it
+		entry->virtualPage = (unsigned) virtAddr / PageSize;
+		entry->physicalPage = physAddr / PageSize;
+		entry->asid = currentASID;
+		entry->valid = TRUE;
+		entry->readOnly = FALSE;
+		entry->use = entry->dirty = FALSE;
+	    }
+	    cache = (event == TraceFetch) ? icache : dcache;
+	    if (cache != NULL)
+		stallTicks += cache->Access(physAddr, writing);
+	    break;
+	  case TraceSpace:
+	    currentASID = virtAddr;
+	    break;
+	  default:				// just counted
+	    break;
+	}
+    }
+    return stallTicks;
+}
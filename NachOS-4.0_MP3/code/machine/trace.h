@@ -0,0 +1,75 @@
+// trace.h
+//	Data structures to record a trace of what a user program does,
+//	and to play it back.
+//
+//	The trace has a record for every instruction fetched, every
+//	load and store, every system call or other exception, every
+//	interrupt, and every switch to another address space.  Fetches,
+//	loads and stores carry both the virtual and the physical address,
+//	so a trace can be fed back through the TLB (which needs the 
+//	virtual address and the address space id) and the caches (which
+//	are physically addressed) without running the kernel again (see
+//	Machine::Replay).  That makes it cheap to try many TLB and cache
+//	configurations against one recorded run.
+//
+//	Each record is TraceRecordSize bytes: the kind of event, then two
+//	words in the host's byte order.  The trace is read and written
+//	in large blocks.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+// What a trace record says happened, and what its two words hold.
+
+enum TraceEvent { TraceFetch,		// virtual PC, physical address
+		  TraceLoad,		// virtual, physical address
+		  TraceStore,		// virtual, physical address
+		  TraceSyscall,		// system call code, unused
+		  TraceFault,		// ExceptionType, bad virtual address
+		  TraceInterrupt,	// IntType, unused
+		  TraceSpace,		// address space id, unused
+
+		  NumTraceEvents
+};
+
+const int TraceRecordSize = 1 + 2 * sizeof(int);
+const int TraceBufferSize = 4096 * TraceRecordSize;
+
+// The following class defines a trace file, open either for recording
+// or for playing back.
+
+class Trace {
+  public:
+    Trace(char *fileName, bool recording);
+				// Open the trace file, creating it (or
+				// emptying it) if we are recording
+    ~Trace();			// Write out what is buffered, and close it
+
+    void Record(TraceEvent event, int first, int second);
+				// Add a record to the end of the trace
+
+    bool Next(TraceEvent *event, int *first, int *second);
+				// Read the next record; FALSE at the end
+
+    void Print();		// Print how many of each event there were
+
+  private:
+    char *name;
+    int fd;			// UNIX file holding the trace
+    bool writing;		// recording, or playing back?
+    char *buffer;		// records on their way to or from the file
+    int used;			// bytes of buffer recorded, or played back
+    int filled;			// bytes of buffer read from the file
+    int count[NumTraceEvents];	// records of each kind so far
+};
+
+#endif // TRACE_H
@@ -31,6 +31,9 @@
 
 #include "copyright.h"
 #include "main.h"
+#include "mipssim.h"
+#include "cache.h"
+#include "trace.h"
 
 // Routines for converting Words and Short Words to and from the
 // simulated machine's format of little endian.  These end up
@@ -75,7 +78,8 @@ ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
 //	the location pointed to by "value".
 //
 //   	Returns FALSE if the translation step from virtual to physical memory
-//   	failed.
+//   	failed.  If there is a data cache, a miss adds to the cost of
+//	the instruction being run.
 //
 //	"addr" -- the virtual address to read from
 //	"size" -- the number of bytes to read (1, 2, or 4)
@@ -88,27 +92,35 @@ Machine::ReadMem(int addr, int size, int *value)
     int data;
     ExceptionType exception;
     int physicalAddress;
+    char *hostAddr = HostAddress(addr, size, FALSE);
     
-    DEBUG(dbgAddr, "Reading VA " << addr << ", size " << size);
+    if (hostAddr == NULL) {		// not in the translation cache
+	DEBUG(dbgAddr, "Reading VA " << addr << ", size " << size);
     
-    exception = Translate(addr, &physicalAddress, size, FALSE);
-    if (exception != NoException) {
-	RaiseException(exception, addr);
-	return FALSE;
+	exception = Translate(addr, &physicalAddress, size, FALSE);
+	if (exception != NoException) {
+	    RaiseException(exception, addr);
+	    return FALSE;
+	}
+	hostAddr = &mainMemory[physicalAddress];
     }
+    if (dcache != NULL)
+	instrTicks += dcache->Access(hostAddr - mainMemory, FALSE);
+    if (trace != NULL)
+	trace->Record(TraceLoad, addr, hostAddr - mainMemory);
     switch (size) {
       case 1:
-	data = mainMemory[physicalAddress];
+	data = *hostAddr;
 	*value = data;
 	break;
 	
       case 2:
-	data = *(unsigned short *) &mainMemory[physicalAddress];
+	data = *(unsigned short *) hostAddr;
 	*value = ShortToHost(data);
 	break;
 	
       case 4:
-	data = *(unsigned int *) &mainMemory[physicalAddress];
+	data = *(unsigned int *) hostAddr;
 	*value = WordToHost(data);
 	break;
 
@@ -125,7 +137,8 @@ Machine::ReadMem(int addr, int size, int *value)
 //	virtual memory at location "addr".
 //
 //   	Returns FALSE if the translation step from virtual to physical memory
-//   	failed.
+//   	failed.  If there is a data cache, a miss adds to the cost of
+//	the instruction being run.
 //
 //	"addr" -- the virtual address to write to
 //	"size" -- the number of bytes to be written (1, 2, or 4)
@@ -137,32 +150,46 @@ Machine::WriteMem(int addr, int size, int value)
 {
     ExceptionType exception;
     int physicalAddress;
+    char *hostAddr = HostAddress(addr, size, TRUE);
      
-    DEBUG(dbgAddr, "Writing VA " << addr << ", size " << size << ", value " << value);
+    if (hostAddr == NULL) {		// not in the translation cache
+	DEBUG(dbgAddr, "Writing VA " << addr << ", size " << size << ", value " << value);
 
-    exception = Translate(addr, &physicalAddress, size, TRUE);
-    if (exception != NoException) {
-	RaiseException(exception, addr);
-	return FALSE;
+	exception = Translate(addr, &physicalAddress, size, TRUE);
+	if (exception != NoException) {
+	    RaiseException(exception, addr);
+	    return FALSE;
+	}
+	hostAddr = &mainMemory[physicalAddress];
+    } else {
+	physicalAddress = hostAddr - mainMemory;
     }
+    if (dcache != NULL)
+	instrTicks += dcache->Access(physicalAddress, TRUE);
+    if (trace != NULL)
+	trace->Record(TraceStore, addr, physicalAddress);
     switch (size) {
       case 1:
-	mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
+	*hostAddr = (unsigned char) (value & 0xff);
 	break;
 
       case 2:
-	*(unsigned short *) &mainMemory[physicalAddress]
+	*(unsigned short *) hostAddr
 		= ShortToMachine((unsigned short) (value & 0xffff));
 	break;
       
       case 4:
-	*(unsigned int *) &mainMemory[physicalAddress]
+	*(unsigned int *) hostAddr
 		= WordToMachine((unsigned int) value);
 	break;
 	
       default: ASSERT(FALSE);
     }
-    
+    decodeCache[physicalAddress / 4].opCode = OP_NOTDECODED;
+    				// the word may hold an instruction we
+				// have already decoded
+    if (blocksInPage[physicalAddress / PageSize] > 0)
+	DropBlocks(physicalAddress, size);
     return TRUE;
 }
 
@@ -175,6 +202,14 @@ Machine::WriteMem(int addr, int size, int value)
 //	address in "physAddr".  If there was an error, returns the type
 //	of the exception.
 //
+//	Successful translations are also remembered in hostReadCache (and,
+//	for writes, hostWriteCache), so that later accesses to the same
+//	page can skip all of this.  The use and dirty bits have been set
+//	by then, so skipping the update does not change them.  We don't 
+//	cache anything while address translation is being traced, or
+//	when there is a TLB, so that every reference is counted (and
+//	aged, for LRU replacement) as a TLB hit or miss.
+//
 //	"virtAddr" -- the virtual address to translate
 //	"physAddr" -- the place to store the physical address
 //	"size" -- the amount of memory being read or written
@@ -188,6 +223,12 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     unsigned int vpn, offset;
     TranslationEntry *entry;
     unsigned int pageFrame;
+    char *hostAddr = HostAddress(virtAddr, size, writing);
+
+    if (hostAddr != NULL) {
+	*physAddr = hostAddr - mainMemory;
+	return NoException;
+    }
 
     DEBUG(dbgAddr, "\tTranslate " << virtAddr << (writing ? " , write" : " , read"));
 
@@ -215,17 +256,21 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	}
 	entry = &pageTable[vpn];
     } else {
-        for (entry = NULL, i = 0; i < TLBSize; i++)
-    	    if (tlb[i].valid && (tlb[i].virtualPage == ((int)vpn))) {
+        for (entry = NULL, i = 0; i < tlbSize; i++)
+    	    if (tlb[i].valid && (tlb[i].virtualPage == ((int)vpn))
+			&& (tlb[i].asid == currentASID)) {
 		entry = &tlb[i];			// FOUND!
+		tlbLastUse[i] = ++tlbClock;
 		break;
 	    }
 	if (entry == NULL) {				// not found
+	    kernel->stats->numTLBMisses++;
     	    DEBUG(dbgAddr, "Invalid TLB entry for this virtual page!");
     	    return PageFaultException;		// really, this is a TLB fault,
 						// the page may be in memory,
 						// but not in the TLB
 	}
+	kernel->stats->numTLBHits++;
     }
 
     if (entry->readOnly && writing) {	// trying to write to a read-only page
@@ -246,5 +291,12 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     *physAddr = pageFrame * PageSize + offset;
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
     DEBUG(dbgAddr, "phys addr = " << *physAddr);
+    if (tlb == NULL && !debug->IsEnabled(dbgAddr)) {
+	i = vpn % HostCacheSize;
+	hostReadCache[i].virtualPage = vpn;
+	hostReadCache[i].hostPage = &mainMemory[pageFrame * PageSize];
+	if (writing)
+	    hostWriteCache[i] = hostReadCache[i];
+    }
     return NoException;
 }
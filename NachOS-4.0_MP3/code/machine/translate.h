@@ -40,6 +40,22 @@ class TranslationEntry {
 			// page is referenced or modified.
     bool dirty;         // This bit is set by the hardware every time the
 			// page is modified.
+    int asid;		// For TLB entries only: the address space the
+			// translation belongs to (see Machine::currentASID).
+};
+
+// The following class defines an entry in the simulator's own cache of
+// recent translations, which maps a virtual page straight to where it
+// lives in mainMemory.  It is not part of the simulated hardware: 
+// entries are only made once Translate has checked the page and set its
+// use (and dirty) bits, and they must be thrown away whenever the page
+// table or TLB changes (see Machine::FlushTranslations).
+
+class HostTranslation {
+  public:
+    int virtualPage;	// The page number in virtual memory, or -1
+			// if the entry is empty.
+    char *hostPage;	// The start of that page in mainMemory.
 };
 
 #endif
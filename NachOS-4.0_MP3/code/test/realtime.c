@@ -0,0 +1,21 @@
+#include "syscall.h"
+
+int main(void)
+{
+	int result, i;
+
+	result = RealTime(1000, 2000);		/* budget longer than period */
+	PrintInt(result);
+	if (result != 0) MSG("Failed on refusing a real-time budget");
+	result = RealTime(1000, 200);
+	PrintInt(result);
+	if (result != 1) MSG("Failed on becoming real-time");
+	for (i = 0; i < 3; ++i) {
+		PrintInt(i);
+		ThreadYield();			/* wait for the next period */
+	}
+	result = RealTime(0, 0);		/* an ordinary thread again */
+	PrintInt(result);
+	if (result != 1) MSG("Failed on leaving real-time");
+	Halt();
+}
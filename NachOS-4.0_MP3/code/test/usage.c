@@ -0,0 +1,16 @@
+#include "syscall.h"
+
+int main(void)
+{
+	int what, count;
+
+	ThreadYield();				/* something to count */
+	for (what = USAGE_USER_TICKS; what <= USAGE_LOCK_TICKS; ++what) {
+		count = Usage(-1, what);
+		PrintInt(count);
+		if (count < 0) MSG("Failed on reading a usage count");
+	}
+	if (Usage(-1, USAGE_USER_TICKS) <= 0) MSG("Failed on counting user ticks");
+	if (Usage(1000, USAGE_USER_TICKS) != -1) MSG("Failed on an unknown program");
+	Halt();
+}
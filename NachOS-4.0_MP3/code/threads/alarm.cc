@@ -52,4 +52,8 @@ Alarm::CallBack()
     if (status != IdleMode) {
 	interrupt->YieldOnReturn();
     }
+    if (status == UserMode) {
+	kernel->CheckpointIfDue();	// -ckpt
+    }
+    kernel->BalanceLoad();		// -procs
 }
@@ -28,6 +28,36 @@ Kernel::Kernel(int argc, char **argv)
 {
     randomSlice = FALSE; 
     debugUserProg = FALSE;
+    blockSim = FALSE;
+    blockStats = FALSE;
+#ifdef USE_TLB
+    tlbSize = TLBSize;
+#else
+    tlbSize = 0;		// default is a linear page table
+#endif
+    tlbPolicy = TLBFifo;
+    profiling = FALSE;
+    costModel = NULL;
+    icacheSize = dcacheSize = 0;	// default is no caches
+    dcachePolicy = WriteBack;
+    cacheMissPenalty = MemoryTime;
+    traceFile = replayFile = NULL;
+    numProcs = 1;
+    procNum = 0;
+    reportPipe = workPipe = -1;
+    board = NULL;
+    wantWork = FALSE;
+    for (int i = 0; i < 10; i++) {
+	execAffinity[i] = -1;		// any process
+	execProc[i] = 0;
+    }
+    checkpointFile = restoreFile = NULL;
+    restoreFd = -1;
+    fairShare = FALSE;
+    schedLogSize = 0;
+    threadPoolSize = ThreadPoolSize;
+    printSwitches = FALSE;
+    printUsage = FALSE;
     consoleIn = NULL;          // default is stdin
     consoleOut = NULL;         // default is stdout
 #ifndef FILESYS_STUB
@@ -45,6 +75,99 @@ Kernel::Kernel(int argc, char **argv)
 	    	i++;
         } else if (strcmp(argv[i], "-s") == 0) {
             debugUserProg = TRUE;
+        } else if (strcmp(argv[i], "-bb") == 0) {
+            blockSim = TRUE;
+        } else if (strcmp(argv[i], "-bbstats") == 0) {
+            blockSim = blockStats = TRUE;
+        } else if (strcmp(argv[i], "-tlb") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is the TLB size
+            tlbSize = atoi(argv[i + 1]);
+            ASSERT(tlbSize >= 0);
+            i++;
+        } else if (strcmp(argv[i], "-tlbp") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is fifo, lru or random
+            if (strcmp(argv[i + 1], "lru") == 0) {
+                tlbPolicy = TLBLru;
+            } else if (strcmp(argv[i + 1], "random") == 0) {
+                tlbPolicy = TLBRandom;
+            } else {
+                ASSERT(strcmp(argv[i + 1], "fifo") == 0);
+                tlbPolicy = TLBFifo;
+            }
+            i++;
+        } else if (strcmp(argv[i], "-prof") == 0) {
+            profiling = TRUE;
+        } else if (strcmp(argv[i], "-cost") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is flat, r3000 or r4000
+            costModel = FindCostModel(argv[i + 1]);
+            ASSERT(costModel != NULL);
+            i++;
+        } else if (strcmp(argv[i], "-icache") == 0) {
+            ASSERT(i + 3 < argc);   // size, ways and line size in bytes
+            icacheSize = atoi(argv[i + 1]);
+            icacheWays = atoi(argv[i + 2]);
+            icacheLine = atoi(argv[i + 3]);
+            i += 3;
+        } else if (strcmp(argv[i], "-dcache") == 0) {
+            ASSERT(i + 4 < argc);   // as -icache, then wb or wt
+            dcacheSize = atoi(argv[i + 1]);
+            dcacheWays = atoi(argv[i + 2]);
+            dcacheLine = atoi(argv[i + 3]);
+            if (strcmp(argv[i + 4], "wt") == 0) {
+                dcachePolicy = WriteThrough;
+            } else {
+                ASSERT(strcmp(argv[i + 4], "wb") == 0);
+                dcachePolicy = WriteBack;
+            }
+            i += 4;
+        } else if (strcmp(argv[i], "-missp") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is the miss penalty
+            cacheMissPenalty = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "-trace") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is the trace file
+            traceFile = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-replay") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is the trace file
+            replayFile = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-procs") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is the number of processes
+            numProcs = atoi(argv[i + 1]);
+            ASSERT(numProcs >= 1);
+            i++;
+        } else if (strcmp(argv[i], "-pin") == 0) {
+            ASSERT(i + 1 < argc);   // the process for the last -e program
+            ASSERT(execfileNum > 0);
+            execAffinity[execfileNum] = atoi(argv[i + 1]);
+            ASSERT(execAffinity[execfileNum] >= 0);
+            i++;
+        } else if (strcmp(argv[i], "-fair") == 0) {
+            fairShare = TRUE;
+        } else if (strcmp(argv[i], "-slog") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is the number of events
+            schedLogSize = atoi(argv[i + 1]);
+            ASSERT(schedLogSize > 0);
+            i++;
+        } else if (strcmp(argv[i], "-tpool") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is the number kept
+            threadPoolSize = atoi(argv[i + 1]);
+            ASSERT(threadPoolSize >= 0);
+            i++;
+        } else if (strcmp(argv[i], "-cs") == 0) {
+            printSwitches = TRUE;
+        } else if (strcmp(argv[i], "-usage") == 0) {
+            printUsage = TRUE;
+        } else if (strcmp(argv[i], "-ckpt") == 0) {
+            ASSERT(i + 2 < argc);   // file name, then when to take it
+            checkpointFile = argv[i + 1];
+            checkpointTick = atoi(argv[i + 2]);
+            i += 2;
+        } else if (strcmp(argv[i], "-restore") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is the file name
+            restoreFile = argv[i + 1];
+            i++;
 		} else if (strcmp(argv[i], "-e") == 0) {
         	execfile[++execfileNum]= argv[++i];
 			cout << execfile[execfileNum] << "\n";
@@ -79,8 +202,16 @@ Kernel::Kernel(int argc, char **argv)
             i++;
         } else if (strcmp(argv[i], "-u") == 0) {
             cout << "Partial usage: nachos [-rs randomSeed]\n";
-	   		cout << "Partial usage: nachos [-s]\n";
+	   		cout << "Partial usage: nachos [-s] [-bb] [-bbstats]\n";
             cout << "Partial usage: nachos [-ci consoleIn] [-co consoleOut]\n";
+            cout << "Partial usage: nachos [-tlb #] [-tlbp fifo|lru|random]\n";
+            cout << "Partial usage: nachos [-prof] [-cost flat|r3000|r4000]\n";
+            cout << "Partial usage: nachos [-icache size ways line]\n";
+            cout << "Partial usage: nachos [-dcache size ways line wb|wt] [-missp #]\n";
+            cout << "Partial usage: nachos [-trace file] [-replay file]\n";
+            cout << "Partial usage: nachos [-procs #] [-pin #] [-fair] [-slog #]\n";
+            cout << "Partial usage: nachos [-tpool #] [-cs] [-usage]\n";
+            cout << "Partial usage: nachos [-ckpt file ticks] [-restore file]\n";
 #ifndef FILESYS_STUB
 	    	cout << "Partial usage: nachos [-nf]\n";
 #endif
@@ -89,6 +220,18 @@ Kernel::Kernel(int argc, char **argv)
     }
 }
 
+//----------------------------------------------------------------------
+// PrintSchedLog
+// 	Print what the -slog ring holds when Nachos aborts, so that the
+//	events leading up to a failed ASSERT aren't lost.
+//----------------------------------------------------------------------
+
+static void
+PrintSchedLog()
+{
+    kernel->schedLog->Print();
+}
+
 //----------------------------------------------------------------------
 // Kernel::Initialize
 // 	Initialize Nachos global data structures.  Separate from the 
@@ -104,14 +247,42 @@ Kernel::Initialize()
     // object to save its state. 
 
 	
+    stats = new Statistics();		// collect statistics
+    if (restoreFile != NULL)
+	RestoreStatistics();		// before anything reads the clock
+
     currentThread = new Thread("main", threadNum++);		
     currentThread->setStatus(RUNNING);
-
-    stats = new Statistics();		// collect statistics
+    stats->costModel = costModel;
+    stats->printSwitches = printSwitches;
+    stats->printThreads = printUsage;
+    icache = dcache = NULL;
+    if (icacheSize > 0) {
+	icache = new Cache("I-cache", icacheSize, icacheWays, icacheLine,
+			   WriteBack, cacheMissPenalty);
+	stats->icache = icache;
+    }
+    if (dcacheSize > 0) {
+	dcache = new Cache("D-cache", dcacheSize, dcacheWays, dcacheLine,
+			   dcachePolicy, cacheMissPenalty);
+	stats->dcache = dcache;
+    }
+    trace = NULL;
+    if (replayFile != NULL) {
+	trace = new Trace(replayFile, FALSE);
+	stats->trace = trace;
+    } else if (traceFile != NULL) {
+	trace = new Trace(traceFile, TRUE);
+	stats->trace = trace;
+    }
     interrupt = new Interrupt;		// start up interrupt handling
-    scheduler = new Scheduler();	// initialize the ready queue
+    schedLog = new SchedLog(schedLogSize);
+    CallOnAbort(PrintSchedLog);		// -slog: keep what the ring holds
+    scheduler = new Scheduler(fairShare);	// initialize the ready queue
     alarm = new Alarm(randomSlice);	// start up time slicing
-    machine = new Machine(debugUserProg);
+    machine = new Machine(debugUserProg, blockSim && checkpointFile == NULL,
+			  tlbSize, tlbPolicy, profiling, costModel, icache, dcache,
+			  (replayFile == NULL) ? trace : NULL);
     synchConsoleIn = new SynchConsoleInput(consoleIn); // input from stdin
     synchConsoleOut = new SynchConsoleOutput(consoleOut); // output to stdout
     synchDisk = new SynchDisk();    //
@@ -133,11 +304,19 @@ Kernel::Initialize()
 
 Kernel::~Kernel()
 {
+    schedLog->Print();			// -slog, unless Halt printed it
     delete stats;
     delete interrupt;
     delete scheduler;
+    delete schedLog;
     delete alarm;
     delete machine;
+    if (icache != NULL)
+	delete icache;
+    if (dcache != NULL)
+	delete dcache;
+    if (trace != NULL)
+	delete trace;			// writes out the end of it
     delete synchConsoleIn;
     delete synchConsoleOut;
     delete synchDisk;
@@ -267,22 +446,48 @@ void ForkExecute(Thread *t)
 
 }
 
+//----------------------------------------------------------------------
+// ForkRestored
+// 	Pick up a user program restored from a checkpoint where it left
+//	off: unlike ForkExecute, its memory and registers are already
+//	set up.
+//----------------------------------------------------------------------
+
+void ForkRestored(Thread *t)
+{
+    t->RestoreUserState();
+    t->space->RestoreState();
+    kernel->machine->Run();
+}
+
 void Kernel::ExecAll()
 {
     //MP3
     //threadNum '1' reserved for postal.cc!
     threadNum = 2;
-	for (int i=1;i<=execfileNum;i++) {
-		int a = Exec(execfile[i], tPriority[i]);
-	}
-	currentThread->Finish();
+    if (replayFile != NULL) {
+	int stallTicks = machine->Replay(trace);
+	cout << "Cache misses in the replayed trace would cost " 
+	     << stallTicks << " ticks\n";
+	interrupt->Halt();
+    }
+    if (restoreFd >= 0)
+	RestoreThreads();	// then run any -e programs alongside
+    if (numProcs > 1 && execfileNum > 1)
+	StartProcesses();		// only returns in the copies
+    for (int i=1;i<=execfileNum;i++) {
+	if (execProc[i] == procNum)		// dealt to us
+	    Exec(execfile[i], tPriority[i], execAffinity[i]);
+    }
+    currentThread->Finish();
     //Kernel::Exec();	
 }
 
 
-int Kernel::Exec(char* name, int priority)
+int Kernel::Exec(char* name, int priority, int affinity)
 {
 	t[threadNum] = new Thread(name, threadNum, priority);
+	t[threadNum]->setAffinity(affinity);
 	t[threadNum]->space = new AddrSpace();
 	t[threadNum]->Fork((VoidFunctionPtr) &ForkExecute, (void *)t[threadNum]);
 	threadNum++;
@@ -339,4 +544,422 @@ int Kernel::Close(OpenFileId id)
 	return fileSystem->CloseId(id);
 }
 
+//----------------------------------------------------------------------
+// Kernel::PrintProfile
+// 	If we were asked to profile (-prof), print the instruction counts
+//	by opcode, and then the hot PCs of each program still around.
+//	With -bbstats, first print how often the basic-block engine ran
+//	each fused pair of instructions.
+//----------------------------------------------------------------------
+
+void
+Kernel::PrintProfile()
+{
+    if (blockStats)
+	machine->PrintFusions();
+    if (!machine->Profiling())
+	return;
+    machine->PrintProfile();
+    for (AddrSpace *space = AddrSpace::firstSpace; space != NULL; 
+		space = space->nextSpace)
+	space->PrintProfile();
+}
+
+//----------------------------------------------------------------------
+// SendCacheCounts, ReceiveCacheCounts
+// 	Pass what a cache counted from one Nachos process to another, over
+//	a pipe.  Every process has a cache of the same shape, if any.
+//----------------------------------------------------------------------
+
+static void
+SendCacheCounts(int fd, Cache *cache)
+{
+    int counts[3];
+
+    if (cache == NULL)
+	return;
+    counts[0] = cache->hits;
+    counts[1] = cache->misses;
+    counts[2] = cache->memWrites;
+    WriteFile(fd, (char *) counts, sizeof(counts));
+}
+
+static bool
+ReceiveCacheCounts(int fd, Cache *cache)
+{
+    int counts[3];
+
+    if (cache == NULL)
+	return TRUE;
+    if (ReadPartial(fd, (char *) counts, sizeof(counts)) != sizeof(counts))
+	return FALSE;
+    cache->hits += counts[0];
+    cache->misses += counts[1];
+    cache->memWrites += counts[2];
+    return TRUE;
+}
+
+// Messages between the original Nachos and its -procs copies: what
+// kind, a program (an index into execfile, or -1), and a copy.
+
+enum ProcMessageType { 
+    ProcIdle,		// to the original: I have nothing to run
+    ProcGive,		// to the original: the program you asked me
+			// to give up for a copy, or -1 if I have none
+    ProcHalt,		// to the original: I halted; my statistics follow
+    ProcSteal,		// to a copy: give up a program for another
+    ProcWork		// to a copy: run a program from another
+};
+
+//----------------------------------------------------------------------
+// SendMessage
+// 	Write one of the messages above down a pipe.  It is small enough
+//	to arrive all at once.
+//----------------------------------------------------------------------
+
+static void
+SendMessage(int fd, ProcMessageType type, int program, int proc)
+{
+    int message[3];
+
+    message[0] = type;
+    message[1] = program;
+    message[2] = proc;
+    WriteFile(fd, (char *) message, sizeof(message));
+}
 
+//----------------------------------------------------------------------
+// Kernel::StartProcesses
+// 	Run the -e programs in numProcs copies of this Nachos at once,
+//	each in its own UNIX process, so that on a multiprocessor host
+//	they really run in parallel.  This is NOT a multiprocessor
+//	simulation: each copy is a whole uniprocessor Nachos, with its
+//	own machine (registers, memory, TLB and caches), ready list,
+//	current thread, interrupts and clock, and the copies share no
+//	simulated memory, kernel state or files (only the console, so
+//	their output is interleaved).  The programs are dealt out to the
+//	copies in turn (or to the one they are pinned to with -pin), and
+//	each copy runs its share as if it were the only one.
+//
+//	Returns only in the copies, each with its share of the programs.
+//	The original then balances the load: when a copy runs out of 
+//	things to do (see BalanceLoad), the original asks the copy with
+//	the most programs that haven't started yet to give one up, and
+//	passes it on.  Each copy posts how many it has in a ProcessBoard,
+//	in host memory they share, so this takes no messages until a copy
+//	is idle.  When every copy has halted, the original collects what 
+//	they counted (see SendStatistics), and prints the totals.
+//----------------------------------------------------------------------
+
+void
+Kernel::StartProcesses()
+{
+    int reports[10], works[10];		// pipes from and to each copy
+    bool idle[10];			// waiting for a program
+    int up[2], down[2];
+    int message[3];
+    int proc, i, running, thief, victim = -1;
+    Statistics procStats;
+
+    if (numProcs > execfileNum)		// no point in idle copies
+	numProcs = execfileNum;
+    for (i = 1; i <= execfileNum; i++) {
+	if (execAffinity[i] >= 0)
+	    execAffinity[i] %= numProcs;
+	execProc[i] = (execAffinity[i] >= 0) ? execAffinity[i] 
+					     : (i - 1) % numProcs;
+    }
+    board = (ProcessBoard *) AllocShared(numProcs * sizeof(ProcessBoard));
+    for (proc = 0; proc < numProcs; proc++) {
+	OpenPipe(up);
+	OpenPipe(down);
+	if (ForkProcess() == 0) {	// we are copy "proc"
+	    for (i = 0; i < proc; i++) {
+		::Close(reports[i]);
+		::Close(works[i]);
+	    }
+	    ::Close(up[0]);
+	    ::Close(down[1]);
+	    procNum = proc;
+	    reportPipe = up[1];
+	    workPipe = down[0];
+	    cout << "Process " << proc << ":";
+	    for (i = 1; i <= execfileNum; i++)
+		if (execProc[i] == proc)
+		    cout << " " << execfile[i];
+	    cout << "\n";
+	    return;
+	}
+	::Close(up[1]);
+	::Close(down[0]);
+	reports[proc] = up[0];
+	works[proc] = down[1];
+	idle[proc] = FALSE;
+    }
+
+    for (running = numProcs; running > 0; ) {
+	proc = WaitForFiles(reports, numProcs, 10);
+	if (proc < 0) {
+	    ;				// no news, but a board may have changed
+	} else if (ReadPartial(reports[proc], (char *) message, 
+		sizeof(message)) != sizeof(message)) {
+	    cout << "Process " << proc << " died without halting\n";
+	    message[0] = ProcHalt;
+	} else if (message[0] == ProcIdle) {
+	    idle[proc] = TRUE;
+	} else if (message[0] == ProcGive) {
+	    victim = -1;
+	    thief = message[2];
+	    if (message[1] >= 0) {
+		if (reports[thief] < 0)	// halted since it asked
+		    thief = proc;	// so give it back
+		SendMessage(works[thief], ProcWork, message[1], proc);
+		board[thief].hasMail = TRUE;
+		idle[thief] = FALSE;
+	    }
+	} else if (ReadPartial(reports[proc], (char *) &procStats, 
+		sizeof(Statistics)) != sizeof(Statistics) 
+		|| !ReceiveCacheCounts(reports[proc], icache)
+		|| !ReceiveCacheCounts(reports[proc], dcache)) {
+	    cout << "Process " << proc << " died without halting\n";
+	} else {			// ProcHalt
+	    stats->Accumulate(&procStats);
+	}
+	if (proc >= 0 && message[0] == ProcHalt) {
+	    ::Close(reports[proc]);
+	    ::Close(works[proc]);
+	    reports[proc] = -1;
+	    idle[proc] = FALSE;
+	    running--;
+	    if (victim == proc)		// it won't answer
+		victim = -1;
+	}
+
+	for (thief = 0; thief < numProcs && !idle[thief]; thief++)
+	    ;
+	if (thief == numProcs || victim >= 0)
+	    continue;			// one steal at a time
+	for (i = 0; i < numProcs; i++) {	// from the busiest copy
+	    if (reports[i] >= 0 && !idle[i] && board[i].movable > 0
+		    && (victim < 0 || board[i].movable > board[victim].movable))
+		victim = i;
+	}
+	if (victim >= 0) {
+	    SendMessage(works[victim], ProcSteal, -1, thief);
+	    board[victim].hasMail = TRUE;
+	}
+    }
+    while (WaitForProcess())
+	;
+    cout << "\nAll " << numProcs << " processes halted\n";
+    stats->firstThread = NULL;		// each copy printed its own threads
+    stats->Print();
+    delete kernel;	// Never returns.
+}
+
+//----------------------------------------------------------------------
+// Kernel::BalanceLoad
+// 	If this is one of several Nachos processes (-procs), post how
+//	many of our ready programs could move to another, ask the
+//	original for one if we are idle, and do what it has sent: give
+//	up a program that hasn't started for an idle copy, or run one
+//	from a busy one.
+//	A program that has started stays put -- its memory is here.
+//
+//	Called on each timer interrupt.  Unless the original has flagged
+//	that it sent something, this makes no system calls.
+//----------------------------------------------------------------------
+
+void
+Kernel::BalanceLoad()
+{
+    int message[3];
+    Thread *thread;
+    int program;
+
+    if (reportPipe < 0)
+	return;
+    board[procNum].movable = scheduler->NumMovable();
+    if (interrupt->getStatus() == IdleMode && !wantWork) {
+	SendMessage(reportPipe, ProcIdle, -1, procNum);
+	wantWork = TRUE;
+	stats->numStealRequests++;
+    }
+    if (!board[procNum].hasMail)
+	return;
+    board[procNum].hasMail = FALSE;	// before reading, so none is missed
+    while (PollFile(workPipe)) {
+	::Read(workPipe, (char *) message, sizeof(message));
+	if (message[0] == ProcSteal) {
+	    program = -1;
+	    thread = scheduler->TakeMovable();
+	    if (thread != NULL) {
+		for (program = 1; execfile[program] != thread->getName(); 
+			program++)
+		    ASSERT(program < execfileNum);
+		cout << "Tick " << stats->totalTicks << ": Thread " 
+		     << thread->getID() << " is given to process " << message[2]
+		     << "\n";
+		t[thread->getID()] = NULL;
+		delete thread->space;
+		delete thread;
+	    }
+	    SendMessage(reportPipe, ProcGive, program, message[2]);
+	} else {			// ProcWork
+	    program = message[1];
+	    cout << "Tick " << stats->totalTicks << ": " << execfile[program]
+		 << " is taken from process " << message[2] << "\n";
+	    wantWork = FALSE;
+	    stats->numMigrations++;
+	    Exec(execfile[program], tPriority[program], -1);
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// Kernel::SendStatistics
+// 	If this is one of several processes, send what it counted to the
+//	original Nachos, which prints the totals (see StartProcesses).
+//----------------------------------------------------------------------
+
+void
+Kernel::SendStatistics()
+{
+    if (reportPipe < 0)
+	return;
+    SendMessage(reportPipe, ProcHalt, -1, procNum);
+    WriteFile(reportPipe, (char *) stats, sizeof(Statistics));
+    SendCacheCounts(reportPipe, icache);
+    SendCacheCounts(reportPipe, dcache);
+    ::Close(reportPipe);
+    reportPipe = -1;
+}
+
+// A checkpoint file starts with this, and the size of the machine
+// that wrote it.
+
+const int CheckpointMagic = 0x434b5054;
+
+//----------------------------------------------------------------------
+// Kernel::CheckpointIfDue
+// 	If we were asked to (-ckpt), and it is time, write a snapshot of
+//	the system to the checkpoint file, to be picked up later by
+//	-restore; any number of runs can start from the same snapshot.
+//	The snapshot has the clock and the statistics, all of
+//	mainMemory, and each user program's page table, registers and
+//	scheduling state.
+//
+//	Called on a timer interrupt that stopped user code.  A kernel
+//	thread can't be saved (only its stack knows where it was), so
+//	the snapshot is put off to a later interrupt unless every thread
+//	is a user program stopped in user code, rather than in a system
+//	call.  Devices aren't saved: they start out idle on restore, as
+//	do the TLB and the caches.
+//----------------------------------------------------------------------
+
+void
+Kernel::CheckpointIfDue()
+{
+    Thread *threads[NumASIDs];
+    int header[3] = { CheckpointMagic, MemorySize, NumPhysPages };
+    int count, programs = 0;
+    int i, fd;
+
+    if (checkpointFile == NULL || stats->totalTicks < checkpointTick)
+	return;
+    for (AddrSpace *space = AddrSpace::firstSpace; space != NULL; 
+		space = space->nextSpace)
+	programs++;
+    if (programs > NumASIDs)
+	return;				// more than we have room for
+    if (currentThread->space == NULL || !currentThread->getUserLevel())
+	return;
+    count = 1 + scheduler->NumReady();
+    if (count != programs)
+	return;				// someone is blocked, or not a program
+    threads[0] = currentThread;
+    scheduler->ReadyThreads(threads + 1);	// saved in order
+    for (i = 1; i < count; i++)
+	if (threads[i]->space == NULL || !threads[i]->getUserLevel())
+	    return;			// someone is in the kernel
+
+    fd = OpenForWrite(checkpointFile);
+    WriteFile(fd, (char *) header, sizeof(header));
+    WriteFile(fd, (char *) stats, sizeof(Statistics));
+    WriteFile(fd, machine->mainMemory, MemorySize);
+    WriteFile(fd, (char *) AddrSpace::usedPhysPage, 
+		sizeof(AddrSpace::usedPhysPage));
+    WriteFile(fd, (char *) &count, sizeof(int));
+    for (i = 0; i < count; i++) {
+	threads[i]->Checkpoint(fd);
+	threads[i]->space->Checkpoint(fd);
+    }
+    ::Close(fd);
+    cout << "Tick " << stats->totalTicks << ": checkpoint of " << count 
+	<< " threads written to " << checkpointFile << "\n";
+    checkpointFile = NULL;		// only the one
+}
+
+//----------------------------------------------------------------------
+// Kernel::RestoreStatistics
+// 	Open the -restore snapshot, and set the clock and the statistics
+//	from it.  This has to happen before the devices start, so that
+//	they schedule their interrupts from the restored time.
+//----------------------------------------------------------------------
+
+void
+Kernel::RestoreStatistics()
+{
+    int header[3];
+    Statistics saved;
+
+    restoreFd = OpenForReadWrite(restoreFile, TRUE);
+    ::Read(restoreFd, (char *) header, sizeof(header));
+    ASSERT(header[0] == CheckpointMagic);
+    ASSERT(header[1] == MemorySize && header[2] == NumPhysPages);
+    ::Read(restoreFd, (char *) &saved, sizeof(Statistics));
+    *stats = saved;
+    stats->icache = stats->dcache = NULL;	// pointers into the old run
+    stats->trace = NULL;
+    stats->firstThread = stats->lastThread = NULL;
+}
+
+//----------------------------------------------------------------------
+// Kernel::RestoreThreads
+// 	Finish restoring the -restore snapshot: put back mainMemory, and
+//	make a thread for each user program in it, ready to go on from
+//	where it was stopped (see CheckpointIfDue).  The threads keep
+//	their ids, and queue up again in the order they were saved.
+//----------------------------------------------------------------------
+
+void
+Kernel::RestoreThreads()
+{
+    Thread *thread;
+    int count, waitTime;
+    bool jump;
+
+    ::Read(restoreFd, machine->mainMemory, MemorySize);
+    ::Read(restoreFd, (char *) AddrSpace::usedPhysPage, 
+		sizeof(AddrSpace::usedPhysPage));
+    for (int i = 0; i < NumPhysPages; i++)
+	machine->InvalidateDecodedPage(i);
+    ::Read(restoreFd, (char *) &count, sizeof(int));
+    for (int i = 0; i < count; i++) {
+	thread = Thread::Restore(restoreFd);
+	ASSERT(thread->getID() >= 2 && thread->getID() < 10);
+	thread->space = new AddrSpace();
+	thread->space->Restore(restoreFd);
+	t[thread->getID()] = thread;
+	thread->setAffinity(procNum);	// its memory is here
+	threadNum = max(threadNum, thread->getID() + 1);
+	waitTime = thread->getWaitTime();	// ReadyToRun resets these
+	jump = thread->getJump();
+	thread->Fork((VoidFunctionPtr) &ForkRestored, (void *) thread);
+	scheduler->RestoreThread(thread, waitTime, jump);
+    }
+    ::Close(restoreFd);
+    restoreFd = -1;
+    cout << "Tick " << stats->totalTicks << ": restored " << count 
+	<< " threads from " << restoreFile << "\n";
+}
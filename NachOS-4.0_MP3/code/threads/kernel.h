@@ -13,11 +13,14 @@
 #include "utility.h"
 #include "thread.h"
 #include "scheduler.h"
+#include "schedlog.h"
 #include "interrupt.h"
 #include "stats.h"
 #include "alarm.h"
 #include "filesys.h"
 #include "machine.h"
+#include "cache.h"
+#include "trace.h"
 
 class PostOfficeInput;
 class PostOfficeOutput;
@@ -25,7 +28,15 @@ class SynchConsoleInput;
 class SynchConsoleOutput;
 class SynchDisk;
 
+// What each of the -procs copies of Nachos shows the original, in host
+// memory they share (see Kernel::StartProcesses).  Looking at it takes
+// no system call, so a busy copy can afford to on every timer interrupt.
 
+class ProcessBoard {
+  public:
+    volatile int movable;	// ready programs the copy could give away
+    volatile bool hasMail;	// the original has written to its pipe
+};
 
 class Kernel {
   public:
@@ -38,7 +49,7 @@ class Kernel {
 				// refers to "kernel" as a global
 	void ExecAll();
     //MP3 modified ver.
-	int Exec(char* name, int priority);
+	int Exec(char* name, int priority, int affinity);
     void ThreadSelfTest();	// self test of threads and synchronization
 	
     void ConsoleTest();         // interactive console self test
@@ -51,11 +62,20 @@ class Kernel {
 	int Read(char *buf, int size, OpenFileId id);
 	int Close(OpenFileId id);
 
+    void PrintProfile();	// print what -prof and -bbstats counted
+    void SendStatistics();	// if we are one of several copies (-procs),
+				// hand our statistics back to the first
+    void BalanceLoad();		// called on each timer interrupt, to
+				// move programs to idle copies (-procs)
+    void CheckpointIfDue();	// called on each timer interrupt from user
+				// code, to take the -ckpt snapshot
+
 // These are public for notational convenience; really, 
 // they're global variables used everywhere.
 
     Thread *currentThread;	// the thread holding the CPU
     Scheduler *scheduler;	// the ready list
+    SchedLog *schedLog;		// what the scheduler has done
     Interrupt *interrupt;	// interrupt status
     Statistics *stats;		// performance metrics
     Alarm *alarm;		// the software alarm clock    
@@ -68,19 +88,63 @@ class Kernel {
     PostOfficeOutput *postOfficeOut;
 
     int hostName;               // machine identifier
+    int threadPoolSize;		// finished threads to keep for reuse
 
   private:
+    void StartProcesses();	// split the programs among -procs copies
+				// of Nachos, and report on them all
+    void RestoreStatistics();	// start the clock where -restore left it
+    void RestoreThreads();	// put back memory and the user programs
 
 	Thread* t[10];
 	char*   execfile[10];
     //MP3
     int tPriority[10];
 	int priorityNum;
+    int execAffinity[10];	// copy each program is pinned to (-pin),
+				// or -1 if it may move
+    int execProc[10];		// copy each program is dealt to
 
     int execfileNum;
 	int threadNum;
     bool randomSlice;		// enable pseudo-random time slicing
     bool debugUserProg;         // single step user program
+    bool blockSim;		// run user programs a basic block at a time
+    bool blockStats;		// print how often fused pairs ran
+    int tlbSize;		// TLB entries, or 0 to use page tables
+    TLBPolicy tlbPolicy;	// TLB replacement policy
+    bool profiling;		// count instructions by opcode and PC
+    CostModel *costModel;	// what user instructions cost, or NULL
+				// for UserTick apiece
+    int icacheSize, icacheWays, icacheLine;
+				// instruction cache geometry, or 0 bytes
+				// for no cache
+    int dcacheSize, dcacheWays, dcacheLine;
+    WritePolicy dcachePolicy;	// data cache geometry and write policy
+    int cacheMissPenalty;	// ticks to fill (or write back) a line
+    Cache *icache;		// the caches the machine uses, if any
+    Cache *dcache;
+    char *traceFile;		// where to record a trace (-trace), or NULL
+    char *replayFile;		// trace to play back instead (-replay)
+    Trace *trace;		// the one being recorded or played back
+    int numProcs;		// copies of Nachos (host processes) to
+				// run the programs in
+    int procNum;		// which one this is
+    int reportPipe;		// where this copy sends its requests and
+				// statistics, or -1 if it is the only one
+    int workPipe;		// where the original's answers come from
+    ProcessBoard *board;	// one for each copy
+    bool wantWork;		// asked for a program, none given yet
+    bool fairShare;		// L3 shares the CPU by virtual runtime
+    int schedLogSize;		// scheduler events to keep for printing
+				// at halt (-slog), or 0 to print each
+    bool printSwitches;		// count the context switches that do and
+				// don't reload the address space (-cs)
+    bool printUsage;		// report what each thread used (-usage)
+    char *checkpointFile;	// where to save a snapshot of the system,
+    int checkpointTick;		// and the time to take it (or soon after)
+    char *restoreFile;		// snapshot to start from instead of booting
+    int restoreFd;		// open snapshot, until it's been read
     double reliability;         // likelihood messages are dropped
     char *consoleIn;            // file to read console input from
     char *consoleOut;           // file to send console output to
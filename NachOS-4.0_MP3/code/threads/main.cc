@@ -3,7 +3,15 @@
 //	operating system kernel.  
 //
 // Usage: nachos -d <debugflags> -rs <random seed #>
-//              -s -x <nachos file> -ci <consoleIn> -co <consoleOut>
+//              -s -bb -bbstats -x <nachos file> -ci <consoleIn> -co <consoleOut>
+//              -tlb <# of entries> -tlbp <fifo|lru|random> -prof
+//              -cost <flat|r3000|r4000>
+//              -icache <size> <ways> <line size>
+//              -dcache <size> <ways> <line size> <wb|wt> -missp <ticks>
+//              -trace <trace file> -replay <trace file>
+//              -procs <# of processes> -pin <process #> -fair -slog <# of events>
+//              -tpool <# of threads> -cs -usage
+//              -ckpt <checkpoint file> <ticks> -restore <checkpoint file>
 //              -f -cp <unix file> <nachos file>
 //              -p <nachos file> -r <nachos file> -l -D
 //              -n <network reliability> -m <machine id>
@@ -13,6 +21,54 @@
 //    -rs causes Yield to occur at random (but repeatable) spots
 //    -z prints the copyright message
 //    -s causes user programs to be executed in single-step mode
+//    -bb runs user programs with the basic-block engine (same results,
+//	  faster; ignored with -s, -tlb, -prof, -cost, -icache, -dcache,
+//	  -trace, -ckpt or the 'm', 'a' or 'i' debug flags)
+//    -bbstats is -bb, and also prints how many times each fused pair
+//	  of instructions ran when Nachos halts
+//    -tlb translates user addresses through a software-loaded TLB of
+//	  the given size instead of the page table
+//    -tlbp sets the TLB replacement policy (FIFO is the default)
+//    -prof counts the user instructions run, by opcode and by PC, and
+//	  prints the counts when Nachos halts (turns off -bb)
+//    -cost charges each user instruction by its class (ALU, load, 
+//	  multiply, ...) under the named cost model, instead of one tick
+//	  apiece, and reports it when Nachos halts (turns off -bb)
+//    -icache and -dcache simulate set-associative instruction and data
+//	  caches (sizes in bytes, power of two; wb or wt for write-back or
+//	  write-through); each miss costs -missp ticks, MemoryTime by
+//	  default, and the hit ratios are printed when Nachos halts
+//	  (turns off -bb)
+//    -trace records every instruction fetch, load, store, system call,
+//	  interrupt and address space switch in a binary trace file
+//	  (turns off -bb); -replay plays such a trace back through the
+//	  TLB and caches given by -tlb, -icache and -dcache, instead of
+//	  running any programs, and prints their hit ratios
+//    -procs runs the -e programs in that many copies of Nachos, each a
+//	  separate host process with its own machine and kernel (not a
+//	  simulated multiprocessor: they share no memory); the programs
+//	  are dealt out in turn, and the combined statistics are printed
+//	  when the last copy halts; a copy with nothing to run takes a
+//	  program that hasn't started yet from the busiest one
+//    -pin keeps the -e program before it in that copy
+//    -fair runs the L3 threads (priority 0-49) least virtual runtime
+//	  first instead of round robin: the user ticks each has run,
+//	  scaled by a weight that grows with its priority, so they share
+//	  the CPU in proportion to their weights
+//    -slog keeps the scheduler's "Tick N: Thread X ..." lines as binary
+//	  records in a ring of that many, instead of printing each one as
+//	  it happens, and prints the last that many when Nachos halts
+//    -tpool keeps up to that many finished threads, and their stacks,
+//	  for new threads to reuse (16 by default; 0 frees each at once)
+//    -cs prints, when Nachos halts, how many context switches had to
+//	  load another address space, and how many kept the one loaded
+//    -usage prints, when Nachos halts, what each thread used: its
+//	  ticks, context switches, page faults, disk and console I/O,
+//	  and time waiting for locks
+//    -ckpt saves a snapshot of the user programs, memory and clock
+//	  once that many ticks have gone by and every program is in user
+//	  code (turns off -bb); -restore starts from such a snapshot
+//	  instead of loading programs, and runs any -e programs as well
 //    -x runs a user program
 //    -ci specify file for console input (stdin is the default)
 //    -co specify file for console output (stdout is the default)
@@ -0,0 +1,481 @@
+// runqueue.cc
+//	Routines to manage the MP3 ready queues: a PriorityQueue for L2,
+//	and a BurstQueue for L1.  See runqueue.h.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "debug.h"
+#include "runqueue.h"
+
+//----------------------------------------------------------------------
+// HighestBit
+// 	Return the number of the highest bit set in "word", which must
+//	not be zero.
+//----------------------------------------------------------------------
+
+static int
+HighestBit(unsigned int word)
+{
+    int bit = 0;
+
+    if (word & 0xffff0000) { word >>= 16; bit += 16; }
+    if (word & 0xff00) { word >>= 8; bit += 8; }
+    if (word & 0xf0) { word >>= 4; bit += 4; }
+    if (word & 0xc) { word >>= 2; bit += 2; }
+    if (word & 0x2) { bit += 1; }
+    return bit;
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::PriorityQueue
+// 	Initialize an empty priority queue.
+//----------------------------------------------------------------------
+
+PriorityQueue::PriorityQueue()
+{
+    for (int p = 0; p < NumPriorities; p++) {
+	first[p] = last[p] = NULL;
+	shuffled[p] = 0;
+    }
+    for (int i = 0; i < PriorityWords; i++) {
+	nonEmpty[i] = 0;
+    }
+    numInList = 0;
+    shuffles = 0;
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::~PriorityQueue
+// 	De-allocate the queue; the threads on it are not touched.
+//----------------------------------------------------------------------
+
+PriorityQueue::~PriorityQueue()
+{
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::Highest
+// 	Return the highest priority below "below" that has any threads,
+//	or -1 if there is none.
+//----------------------------------------------------------------------
+
+int
+PriorityQueue::Highest(int below)
+{
+    int i = (below - 1) / 32;
+    unsigned int word;
+
+    if (below <= 0) {
+	return -1;
+    }
+    word = nonEmpty[i];
+    if ((below % 32) != 0) {		// only the bits under "below"
+	word &= (1u << (below % 32)) - 1;
+    }
+    for (;;) {
+	if (word != 0) {
+	    return i * 32 + HighestBit(word);
+	}
+	if (--i < 0) {
+	    return -1;
+	}
+	word = nonEmpty[i];
+    }
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::Link
+// 	Put a thread at the back of the list for its current priority.
+//----------------------------------------------------------------------
+
+void
+PriorityQueue::Link(Thread *thread)
+{
+    int p = thread->readyLevel;
+
+    thread->readyNext = NULL;
+    thread->readyPrev = last[p];
+    if (last[p] == NULL) {
+	first[p] = thread;
+	nonEmpty[p / 32] |= 1u << (p % 32);
+    } else {
+	last[p]->readyNext = thread;
+    }
+    last[p] = thread;
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::Unlink
+// 	Take a thread out of the list for the priority it was put on.
+//----------------------------------------------------------------------
+
+void
+PriorityQueue::Unlink(Thread *thread)
+{
+    int p = thread->readyLevel;
+
+    if (thread->readyPrev == NULL) {
+	first[p] = thread->readyNext;
+    } else {
+	thread->readyPrev->readyNext = thread->readyNext;
+    }
+    if (thread->readyNext == NULL) {
+	last[p] = thread->readyPrev;
+    } else {
+	thread->readyNext->readyPrev = thread->readyPrev;
+    }
+    if (first[p] == NULL) {
+	nonEmpty[p / 32] &= ~(1u << (p % 32));
+    }
+    thread->readyNext = thread->readyPrev = NULL;
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::Shuffle
+// 	Do what "count" passes of MP3's requeue of L2 (see
+//	Scheduler::CheckReadyQueues) would do to the order of the
+//	queue: each pass takes the first thread of each priority that
+//	may be requeued (id 2 and up), and puts it at the back of that
+//	priority.  The passes are only counted here; each priority's list
+//	catches up the next time it is used.
+//----------------------------------------------------------------------
+
+void
+PriorityQueue::Shuffle(int count)
+{
+    shuffles += count;
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::CatchUp
+// 	Apply the shuffles a priority's list is owed.  After as many as
+//	it has threads that may move, they are all behind the ones that
+//	may not, and from then on the list just goes round.
+//----------------------------------------------------------------------
+
+void
+PriorityQueue::CatchUp(int priority)
+{
+    int moves = shuffles - shuffled[priority];
+    int movable = 0;
+    Thread *t;
+
+    shuffled[priority] = shuffles;
+    if (moves == 0 || first[priority] == last[priority]) {
+	return;
+    }
+    for (t = first[priority]; t != NULL; t = t->readyNext) {
+	if (t->getID() >= 2) {
+	    movable++;
+	}
+    }
+    if (movable == 0) {
+	return;
+    }
+    if (moves > movable) {
+	moves = movable + (moves - movable) % movable;
+    }
+    while (moves-- > 0) {
+	for (t = first[priority]; t->getID() < 2; t = t->readyNext) {
+	    ;
+	}
+	Unlink(t);
+	Link(t);
+    }
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::Append
+// 	Put a thread at the back of the threads with its priority.
+//----------------------------------------------------------------------
+
+void
+PriorityQueue::Append(Thread *thread)
+{
+    int p = thread->getPriority();
+
+    ASSERT(!IsInList(thread));
+    ASSERT(p >= 0 && p < NumPriorities);
+    CatchUp(p);
+    thread->readyLevel = p;
+    Link(thread);
+    numInList++;
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::Remove
+// 	Take a thread off the queue.  Its priority may have changed
+//	since it was put on.
+//----------------------------------------------------------------------
+
+void
+PriorityQueue::Remove(Thread *thread)
+{
+    ASSERT(IsInList(thread));
+    CatchUp(thread->readyLevel);
+    Unlink(thread);
+    thread->readyLevel = -1;
+    numInList--;
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::Front
+// 	Return the first thread of the highest priority, or NULL if the
+//	queue is empty.
+//----------------------------------------------------------------------
+
+Thread *
+PriorityQueue::Front()
+{
+    int p = Highest(NumPriorities);
+
+    if (p < 0) {
+	return NULL;
+    }
+    CatchUp(p);
+    return first[p];
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::RemoveFront
+// 	Take the Front thread off the queue, and return it.  The queue
+//	must not be empty.
+//----------------------------------------------------------------------
+
+Thread *
+PriorityQueue::RemoveFront()
+{
+    Thread *thread = Front();
+
+    ASSERT(thread != NULL);
+    Remove(thread);
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// PriorityQueue::Next
+// 	Return the thread after "thread" on the queue -- the next one of
+//	its priority, or else the first of the next priority down -- or
+//	NULL if it is the last.
+//----------------------------------------------------------------------
+
+Thread *
+PriorityQueue::Next(Thread *thread)
+{
+    int p = thread->readyLevel;
+
+    ASSERT(IsInList(thread));
+    CatchUp(p);
+    if (thread->readyNext != NULL) {
+	return thread->readyNext;
+    }
+    p = Highest(p);
+    if (p < 0) {
+	return NULL;
+    }
+    CatchUp(p);
+    return first[p];
+}
+
+//----------------------------------------------------------------------
+// ThreadHeap::ThreadHeap
+// 	Initialize an empty queue of threads.
+//
+//	"compare" -- how to order the threads (as for SortedList), or
+//		NULL for first come first served
+//	"kind" -- which of a thread's places (Thread::readyIndex) this
+//		heap keeps
+//----------------------------------------------------------------------
+
+ThreadHeap::ThreadHeap(int (*compare)(Thread *x, Thread *y), HeapKind kind)
+{
+    this->compare = compare;
+    this->kind = kind;
+    maxInList = 16;
+    heap = new Thread *[maxInList];
+    numInList = 0;
+    numInserted = 0;
+}
+
+//----------------------------------------------------------------------
+// ThreadHeap::~ThreadHeap
+// 	De-allocate the queue; the threads on it are not touched.
+//----------------------------------------------------------------------
+
+ThreadHeap::~ThreadHeap()
+{
+    delete [] heap;
+}
+
+//----------------------------------------------------------------------
+// ThreadHeap::Before
+// 	Return TRUE if thread "x" should run before "y": it compares
+//	lower, or the same but it was queued first.
+//----------------------------------------------------------------------
+
+bool
+ThreadHeap::Before(Thread *x, Thread *y)
+{
+    int order = (compare == NULL) ? 0 : (*compare)(x, y);
+
+    if (order != 0) {
+	return order < 0;
+    }
+    return x->readyOrder[kind] - y->readyOrder[kind] < 0;
+}
+
+//----------------------------------------------------------------------
+// ThreadHeap::MoveUp
+// 	Put "thread" into the hole at heap[i], or above it, moving the
+//	threads that should run after it down into the hole.
+//----------------------------------------------------------------------
+
+void
+ThreadHeap::MoveUp(int i, Thread *thread)
+{
+    int parent;
+
+    for (; i > 0; i = parent) {
+	parent = (i - 1) / 2;
+	if (!Before(thread, heap[parent])) {
+	    break;
+	}
+	heap[i] = heap[parent];
+	heap[i]->readyIndex[kind] = i;
+    }
+    heap[i] = thread;
+    thread->readyIndex[kind] = i;
+}
+
+//----------------------------------------------------------------------
+// ThreadHeap::MoveDown
+// 	Put "thread" into the hole at heap[i], or below it, moving the
+//	threads that should run before it up into the hole.
+//----------------------------------------------------------------------
+
+void
+ThreadHeap::MoveDown(int i, Thread *thread)
+{
+    int child;
+
+    for (; (child = 2 * i + 1) < numInList; i = child) {
+	if (child + 1 < numInList 
+		&& Before(heap[child + 1], heap[child])) {
+	    child++;
+	}
+	if (!Before(heap[child], thread)) {
+	    break;
+	}
+	heap[i] = heap[child];
+	heap[i]->readyIndex[kind] = i;
+    }
+    heap[i] = thread;
+    thread->readyIndex[kind] = i;
+}
+
+//----------------------------------------------------------------------
+// ThreadHeap::Insert
+// 	Add a thread to the queue, growing the heap if need be.
+//----------------------------------------------------------------------
+
+void
+ThreadHeap::Insert(Thread *thread)
+{
+    ASSERT(!IsInList(thread));
+    if (numInList == maxInList) {
+	Thread **bigger = new Thread *[maxInList * 2];
+
+	for (int i = 0; i < numInList; i++) {
+	    bigger[i] = heap[i];
+	}
+	delete [] heap;
+	heap = bigger;
+	maxInList *= 2;
+    }
+    thread->readyOrder[kind] = numInserted++;
+    MoveUp(numInList++, thread);
+}
+
+//----------------------------------------------------------------------
+// ThreadHeap::Remove
+// 	Take a thread off the queue, wherever it is.
+//----------------------------------------------------------------------
+
+void
+ThreadHeap::Remove(Thread *thread)
+{
+    int i = thread->readyIndex[kind];
+    Thread *last;
+
+    ASSERT(IsInList(thread));
+    thread->readyIndex[kind] = -1;
+    last = heap[--numInList];
+    if (i == numInList) {
+	return;
+    }
+    if (i > 0 && Before(last, heap[(i - 1) / 2])) {
+	MoveUp(i, last);
+    } else {
+	MoveDown(i, last);
+    }
+}
+
+//----------------------------------------------------------------------
+// ThreadHeap::RemoveFront
+// 	Take the first thread to run off the queue, and return it.  The
+//	queue must not be empty.
+//----------------------------------------------------------------------
+
+Thread *
+ThreadHeap::RemoveFront()
+{
+    Thread *front;
+
+    ASSERT(numInList > 0);
+    front = heap[0];
+    Remove(front);
+    return front;
+}
+
+//----------------------------------------------------------------------
+// ThreadHeap::Sorted
+// 	Fill in "threads" with the queued threads, in the order
+//	RemoveFront would take them off.  There must be room for
+//	NumInList of them.
+//
+//	This is a heap sort of a copy of the heap: each step takes the
+//	last to run off the front of the part still a heap, which starts
+//	out as all of it (with the order turned around).
+//----------------------------------------------------------------------
+
+void
+ThreadHeap::Sorted(Thread **threads)
+{
+    Thread *thread;
+    int i, n, child;
+
+    for (n = 0; n < numInList; n++) {	// build a heap, latest at the top
+	for (i = n; i > 0 && Before(threads[(i - 1) / 2], heap[n]); 
+		i = (i - 1) / 2) {
+	    threads[i] = threads[(i - 1) / 2];
+	}
+	threads[i] = heap[n];
+    }
+    while (--n > 0) {			// move the top to the end
+	thread = threads[n];
+	threads[n] = threads[0];
+	for (i = 0; (child = 2 * i + 1) < n; i = child) {
+	    if (child + 1 < n && Before(threads[child], threads[child + 1])) {
+		child++;
+	    }
+	    if (!Before(thread, threads[child])) {
+		break;
+	    }
+	    threads[i] = threads[child];
+	}
+	threads[i] = thread;
+    }
+}
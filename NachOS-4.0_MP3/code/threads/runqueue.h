@@ -0,0 +1,115 @@
+// runqueue.h
+//	Data structures for the MP3 ready queues, that stay fast with
+//	many threads.
+//
+//	A PriorityQueue holds threads by priority, first come first
+//	served within a priority, as the L2 queue needs.  Each of the
+//	NumPriorities priorities has its own list, linked through the
+//	threads themselves, and a bitmap records which lists are
+//	non-empty; so adding a thread, removing any thread, and finding
+//	the one to run next all take constant time.
+//
+//	A ThreadHeap holds threads in any order given by a compare
+//	function, first come first served among equals: by predicted 
+//	burst time for the L1 queue, by arrival (or, with -fair, by
+//	virtual runtime) for L3, and by when they are due to age for
+//	the scheduler's aging queue.  It is a heap, so adding a thread, 
+//	or taking off the front one or any other, takes time proportional
+//	to the log of the number queued.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef RUNQUEUE_H
+#define RUNQUEUE_H
+
+#include "copyright.h"
+#include "thread.h"
+
+const int NumPriorities = 150;		// thread priorities are 0 to 149
+const int PriorityWords = (NumPriorities + 31) / 32;
+
+// The following class defines a queue of threads ordered by priority.
+// A thread can be on only one PriorityQueue at a time.
+
+class PriorityQueue {
+  public:
+    PriorityQueue();			// initialize an empty queue
+    ~PriorityQueue();
+
+    void Append(Thread *thread);	// put at the back of its priority
+    void Remove(Thread *thread);	// take it off, wherever it is
+    bool IsInList(Thread *thread) { return thread->readyLevel >= 0; }
+
+    Thread *Front();			// highest priority, first come;
+					// NULL if the queue is empty
+    Thread *RemoveFront();		// take off the Front thread
+    Thread *Next(Thread *thread);	// the thread after "thread", in
+					// the order RemoveFront would go
+    bool IsEmpty() { return numInList == 0; }
+    int NumInList() { return numInList; }
+
+    void Shuffle(int count);		// do what "count" of MP3's
+					// per-tick requeues of L2 do
+
+  private:
+    Thread *first[NumPriorities];	// the list for each priority
+    Thread *last[NumPriorities];
+    unsigned int nonEmpty[PriorityWords];// bit p set if first[p] != NULL
+    int numInList;
+    int shuffles;			// Shuffle count so far
+    int shuffled[NumPriorities];	// shuffles already applied to each
+					// priority's list
+
+    int Highest(int below);		// highest priority under "below"
+					// with threads, or -1
+    void CatchUp(int priority);		// apply the shuffles it is owed
+    void Unlink(Thread *thread);
+    void Link(Thread *thread);
+};
+
+// The following class defines a queue of threads ordered by "compare"
+// (in the style of SortedList: negative if x should run before y), 
+// first come first served among equals.  With no compare function, it
+// is simply first come first served.  A thread can be on only one
+// ThreadHeap of each kind at a time.
+
+class ThreadHeap {
+  public:
+    ThreadHeap(int (*compare)(Thread *x, Thread *y), HeapKind kind);
+					// initialize an empty queue
+    ~ThreadHeap();
+
+    void Insert(Thread *thread);	// add it, after any equals
+    void Remove(Thread *thread);	// take it off, wherever it is
+    bool IsInList(Thread *thread) { 
+	return thread->readyIndex[kind] >= 0 
+	    && thread->readyIndex[kind] < numInList
+	    && heap[thread->readyIndex[kind]] == thread; }
+    Thread *Front() { return (numInList == 0) ? NULL : heap[0]; }
+    Thread *RemoveFront();		// take off the first to run
+    bool IsEmpty() { return numInList == 0; }
+    int NumInList() { return numInList; }
+
+    void Sorted(Thread **threads);	// fill in the queued threads, in
+					// the order RemoveFront would go
+    Thread *Item(int i) { return heap[i]; }
+					// the i'th queued thread, in no
+					// particular order
+
+  private:
+    int (*compare)(Thread *x, Thread *y);
+    HeapKind kind;			// which place in each thread it keeps
+    Thread **heap;			// each thread comes no later than
+					// its children, at 2i+1 and 2i+2
+    int numInList;
+    int maxInList;			// room in the heap
+    int numInserted;			// for first come first served
+
+    bool Before(Thread *x, Thread *y);	// should x run before y?
+    void MoveUp(int i, Thread *thread);	// fill the hole at heap[i]
+    void MoveDown(int i, Thread *thread);
+};
+
+#endif // RUNQUEUE_H
@@ -0,0 +1,204 @@
+// schedlog.cc
+//	Routines to log what the scheduler does, and to print the log.
+//	See schedlog.h.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "schedlog.h"
+#include "main.h"
+
+static char *queueNames[] = { "RT", "L1", "L2", "L3" };
+
+//----------------------------------------------------------------------
+// SchedLog::SchedLog
+// 	Initialize an empty log.
+//
+//	"size" -- how many of the latest records to keep, to print when
+//		Nachos halts; or 0 to print each record as it is added
+//----------------------------------------------------------------------
+
+SchedLog::SchedLog(int size)
+{
+    ASSERT(size >= 0);
+    this->size = size;
+    ring = (size > 0) ? new SchedRecord[size] : NULL;
+    next = 0;
+    numAdded = 0;
+}
+
+//----------------------------------------------------------------------
+// SchedLog::~SchedLog
+// 	De-allocate the log.
+//----------------------------------------------------------------------
+
+SchedLog::~SchedLog()
+{
+    delete [] ring;
+}
+
+//----------------------------------------------------------------------
+// SchedLog::Add
+// 	Log an event, as of now.
+//
+//	"event" -- what happened
+//	"thread" -- the ID of the thread it happened to
+//	"first", "second" -- what else the record holds (see SchedEvent)
+//----------------------------------------------------------------------
+
+void
+SchedLog::Add(SchedEvent event, int thread, int first, int second)
+{
+    SchedRecord *record = (size > 0) ? &ring[next] : &single;
+
+    record->when = kernel->stats->totalTicks;
+    record->event = event;
+    record->thread = thread;
+    record->first = first;
+    record->second = second;
+    Logged(record);
+}
+
+//----------------------------------------------------------------------
+// SchedLog::AddBurst
+// 	Log that a thread preempts the running one in L1, having the
+//	shorter predicted burst.
+//
+//	"thread", "burst" -- the thread that preempts, and its burst time
+//	"other", "otherBurst" -- the running thread, and its burst time
+//----------------------------------------------------------------------
+
+void
+SchedLog::AddBurst(int thread, double burst, int other, double otherBurst)
+{
+    SchedRecord *record = (size > 0) ? &ring[next] : &single;
+
+    record->when = kernel->stats->totalTicks;
+    record->event = SchedBurstPreempt;
+    record->thread = thread;
+    record->first = other;
+    record->burst = burst;
+    record->otherBurst = otherBurst;
+    Logged(record);
+}
+
+//----------------------------------------------------------------------
+// SchedLog::Logged
+// 	Finish adding a record: keep it in the ring, or if we aren't
+//	keeping any, print it now.
+//----------------------------------------------------------------------
+
+void
+SchedLog::Logged(SchedRecord *record)
+{
+    if (size == 0) {
+	PrintRecord(record);
+	return;
+    }
+    if (++next == size) {
+	next = 0;
+    }
+    numAdded++;
+}
+
+//----------------------------------------------------------------------
+// SchedLog::PrintRecord
+// 	Print a record as the line (or lines) the scheduler used to print
+//	for it, flushing cout where it used to.
+//----------------------------------------------------------------------
+
+void
+SchedLog::PrintRecord(SchedRecord *r)
+{
+    if (r->event != SchedCompare && r->event != SchedBurstPreempt
+	    && r->event != SchedPreempt) {
+	cout << "Tick " << r->when << ": Thread " << r->thread;
+    }
+    switch (r->event) {
+      case SchedInsert:
+	cout << " is inserted into queue " << queueNames[r->first] << "\n";
+	break;
+      case SchedRemove:
+	cout << " is removed from queue " << queueNames[r->first] << "\n";
+	break;
+      case SchedSelect:
+	cout << " is now selected for execution\n";
+	break;
+      case SchedReplace:
+	cout << " is replaced, and it has executed " << r->first
+	     << " ticks\n";
+	break;
+      case SchedPriority:
+	cout << " changes its priority from " << r->first << " to "
+	     << r->second << endl;
+	break;
+      case SchedPromote:
+	cout << " is removed from queue " << queueNames[r->first] << endl;
+	cout << "Tick " << r->when << ": Thread " << r->thread
+	     << " is inserted into queue " << queueNames[r->second] << endl;
+	break;
+      case SchedCompare:
+	cout << (r->first ? "Aging!" : "ReadyToRun!")
+	     << " Two process are in L1: compare the burst time" << endl;
+	break;
+      case SchedBurstPreempt:
+	cout << "\nThread: " << r->thread << " burst time = " << r->burst
+	     << endl;
+	cout << "Current Thread: " << r->first << " burst time = "
+	     << r->otherBurst << endl;
+	cout << "Since new Thread " << r->thread << " has smaller burst time, ";
+	cout << "preempt the currentThread\n\n";
+	break;
+      case SchedPreempt:
+	cout << "Preempt: " << queueNames[r->first] << "\n";
+	break;
+      case SchedRealTime:
+	cout << " is real-time: period " << r->first << ", budget "
+	     << r->second << endl;
+	break;
+      case SchedRefused:
+	cout << " is refused period " << r->first << ", budget "
+	     << r->second << endl;
+	break;
+      case SchedWait:
+	cout << " waits for its next period\n";
+	break;
+      case SchedOverrun:
+	cout << " has used up its budget\n";
+	break;
+      case SchedMiss:
+	cout << " misses its deadline\n";
+	break;
+    }
+}
+
+//----------------------------------------------------------------------
+// SchedLog::Print
+// 	Print the records the ring has kept, oldest first (with -slog,
+//	when Nachos halts, aborts, or is stopped).  They are forgotten
+//	then, so that they aren't printed twice.
+//----------------------------------------------------------------------
+
+void
+SchedLog::Print()
+{
+    int kept = min(numAdded, size);
+    int i;
+
+    if (kept == 0) {
+	return;
+    }
+    cout << "Scheduler log: the last " << kept << " of " << numAdded
+	 << " events\n";
+    i = (numAdded > size) ? next : 0;
+    do {
+	PrintRecord(&ring[i]);
+	if (++i == size) {
+	    i = 0;
+	}
+    } while (i != next);
+    numAdded = next = 0;
+    cout.flush();			// we may be about to abort
+}
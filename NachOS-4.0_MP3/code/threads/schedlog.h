@@ -0,0 +1,86 @@
+// schedlog.h
+//	Data structures for the scheduler's log: the MP3 "Tick N: Thread X
+//	is ..." lines, kept as binary records.
+//
+//	Formatting those lines with cout, as each thing happens, is most
+//	of what the scheduler costs once there are many threads.  So the
+//	scheduler just fills in a record for each event.  By default the
+//	record is printed at once, exactly as the line used to be; with
+//	-slog, the last so many records are kept in a ring instead, and
+//	printed, in the same format, when Nachos halts -- or when it
+//	aborts, or is stopped with ctl-C, as the MP3 programs, which
+//	never halt, have to be.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SCHEDLOG_H
+#define SCHEDLOG_H
+
+#include "copyright.h"
+
+// What a record says happened, and what its two words hold.
+
+enum SchedEvent { SchedInsert,		// queue, unused
+		  SchedRemove,		// queue, unused
+		  SchedSelect,		// unused
+		  SchedReplace,		// ticks it ran, unused
+		  SchedPriority,	// old priority, new priority
+		  SchedPromote,		// queue it left, queue it joined
+		  SchedCompare,		// TRUE if it came from aging
+		  SchedBurstPreempt,	// running thread, unused
+		  SchedPreempt,		// queue, unused
+		  SchedRealTime,	// period, budget
+		  SchedRefused,		// period, budget
+		  SchedWait,		// unused
+		  SchedOverrun,		// unused
+		  SchedMiss		// unused
+};
+
+// The queues, as a record names them.
+
+enum SchedQueue { QueueIdRT, QueueIdL1, QueueIdL2, QueueIdL3 };
+
+// The following defines one record: when, what, which thread, and two
+// words (and, for SchedBurstPreempt, the two threads' burst times).
+
+class SchedRecord {
+  public:
+    int when;
+    SchedEvent event;
+    int thread;
+    int first, second;
+    double burst, otherBurst;
+};
+
+// The following class defines the log.
+
+class SchedLog {
+  public:
+    SchedLog(int size);		// keep the last "size" records, or print
+				// each one as it comes if "size" is 0
+    ~SchedLog();
+
+    void Add(SchedEvent event, int thread, int first = 0, int second = 0);
+				// log what just happened
+    void AddBurst(int thread, double burst, int other, double otherBurst);
+				// log a preemption by a shorter burst
+
+    void Print();		// print the records kept, oldest first,
+				// and forget them
+
+  private:
+    SchedRecord *ring;		// the last "size" records
+    int size;
+    int next;			// where the next one goes
+    int numAdded;		// records so far
+    SchedRecord single;		// the record, when none are kept
+
+    void Logged(SchedRecord *record);
+				// keep it, or print it
+    void PrintRecord(SchedRecord *record);
+				// print one, as the scheduler did
+};
+
+#endif // SCHEDLOG_H
@@ -23,39 +23,79 @@
 #include "scheduler.h"
 #include "main.h"
 
+//----------------------------------------------------------------------
+// IsMovable
+// 	Return TRUE if a ready thread could be handed to another Nachos
+//	process (-procs): it is a user program that hasn't started yet,
+//	so all there is to it is its name and priority, and it isn't
+//	pinned to this one.
+//----------------------------------------------------------------------
+
+static bool
+IsMovable(Thread *thread)
+{
+    return thread->space != NULL && !thread->HasRun() 
+        && thread->getAffinity() < 0;
+}
+
+//----------------------------------------------------------------------
+// BusyTicks
+// 	Return how long the CPU has been running threads (rather than
+//	idle).  A real-time thread's budget is charged in these ticks, so
+//	it isn't charged for the time the CPU waits after it blocks.
+//----------------------------------------------------------------------
+
+static int
+BusyTicks()
+{
+    return kernel->stats->totalTicks - kernel->stats->idleTicks;
+}
+
 //MP3
-int L1cmp(Thread *a, Thread *b) //short time first
+int AgingCmp(Thread *a, Thread *b) //first to age first
+{
+    return a->getWaitTime() - b->getWaitTime();
+}
+int L1Cmp(Thread *a, Thread *b) //shortest burst first
 {
-    double T1 = a->getBurstTime();
-    double T2 = b->getBurstTime();
-    //short time first -> return -1 means don't move(short already first)
-    if(T1 < T2) return -1;
-    else if(T1 == T2)   return 0;
-    else return 1;
+    if (a->getBurstTime() != b->getBurstTime()) {
+        return (a->getBurstTime() < b->getBurstTime()) ? -1 : 1;
+    }
+    return 0;
 }
-int L2cmp(Thread *a, Thread *b) //priority scheduling
+//real-time
+int DeadlineCmp(Thread *a, Thread *b) //earliest deadline first
 {
-    int T1 = a->getPriority();
-    int T2 = b->getPriority();
-    //larger priority first
-    return T2 - T1;
+    return a->rtDeadline - b->rtDeadline;
+}
+//-fair
+int FairCmp(Thread *a, Thread *b) //least virtual runtime first
+{
+    if (a->getVRuntime() != b->getVRuntime()) {
+        return (a->getVRuntime() < b->getVRuntime()) ? -1 : 1;
+    }
+    return 0;
 }
 //MP3: deal with aging issue
 bool Scheduler::CheckAging(Thread *thread)
 {
     int nowOSTime = kernel->stats->totalTicks;
     //check period: per 1500 ticks
-    if(thread->getStatus()==READY && nowOSTime - thread->getWaitTime() >= 1500 && thread->getID()>=2)
+    if(thread->getStatus()==READY && nowOSTime - thread->getWaitTime() >= AgingTicks && thread->getID()>=2)
     {
+        //its own priority ages; one it inherits (see Lock::Acquire) 
+        //may still be higher
         int oldPriority = thread->getPriority();
-        int newPriority = (oldPriority+10>=149)? 149 : oldPriority+10;
-        thread->setPriority(newPriority);
+        int ownPriority = thread->getOwnPriority();
+        thread->setPriority((ownPriority+10>=149)? 149 : ownPriority+10);
+        int newPriority = thread->getPriority();
         //reset the wait time beginning to now
+        agingQueue->Remove(thread);
         thread->setWaitTime(nowOSTime);
+        agingQueue->Insert(thread);
 
         if(oldPriority!=newPriority){
-            cout<<"Tick "<< nowOSTime <<": Thread "<< thread->getID()<<" changes its priority from "
-                << oldPriority <<" to "<< newPriority <<endl;
+            kernel->schedLog->Add(SchedPriority, thread->getID(), oldPriority, newPriority);
         }
         //new to L1
         if(oldPriority < 100 && newPriority >= 100){
@@ -64,13 +104,12 @@ bool Scheduler::CheckAging(Thread *thread)
             }
             QueueL1->Insert(thread);
 
-            cout<<"Tick "<< nowOSTime <<": Thread "<< thread->getID()<<" is removed from queue L2"<<endl;
-            cout<<"Tick "<< nowOSTime <<": Thread "<< thread->getID()<<" is inserted into queue L1"<<endl;
+            kernel->schedLog->Add(SchedPromote, thread->getID(), QueueIdL2, QueueIdL1);
  
             
             if(kernel->currentThread->getPriority() >= 100){
                 if(kernel->currentThread->getID()!=thread->getID()){
-                    cout<<"Aging! Two process are in L1: compare the burst time"<<endl;
+                    kernel->schedLog->Add(SchedCompare, thread->getID(), TRUE);
                     //double actualBT = kernel->stats->userTicks - kernel->currentThread->getStartTime();
                     //double estiBT = 0.5 * actualBT + 0.5 * kernel->currentThread->getBurstTime();
                     /*
@@ -79,10 +118,9 @@ bool Scheduler::CheckAging(Thread *thread)
                         So here, just use previous time's burst time to do comparison!
                     */
                     if(thread->getBurstTime() < kernel->currentThread->getBurstTime()){
-                        cout<<"\nThread: "<<thread->getID()<<" burst time = "<<thread->getBurstTime()<<endl;
-                        cout<<"Current Thread: "<<kernel->currentThread->getID()<<" burst time = "<<kernel->currentThread->getBurstTime()<<endl;
-                        cout<<"Since new Thread "<<thread->getID()<<" has smaller burst time, ";
-                        cout<<"preempt the currentThread\n\n";
+                        kernel->schedLog->AddBurst(thread->getID(), thread->getBurstTime(),
+                            kernel->currentThread->getID(), kernel->currentThread->getBurstTime());
+                        preemptions++;
                         kernel->currentThread->Yield();
                     }
                 }
@@ -92,6 +130,7 @@ bool Scheduler::CheckAging(Thread *thread)
             //but P2 move to L1 after aging
             //In this case, P2 should "preempt" P1
             else if(kernel->currentThread->getPriority()<100 && kernel->currentThread->getID()!=thread->getID()){
+                preemptions++;
                 kernel->currentThread->Yield();
             }
             return true;
@@ -101,11 +140,11 @@ bool Scheduler::CheckAging(Thread *thread)
             if(QueueL3->IsInList(thread)){
                 QueueL3->Remove(thread);
             }
-            QueueL2->Insert(thread);
-            cout<<"Tick "<< nowOSTime <<": Thread "<< thread->getID()<<" is removed from queue L3"<<endl;
-            cout<<"Tick "<< nowOSTime <<": Thread "<< thread->getID()<<" is inserted into queue L2"<<endl;
+            QueueL2->Append(thread);
+            kernel->schedLog->Add(SchedPromote, thread->getID(), QueueIdL3, QueueIdL2);
             
             if(kernel->currentThread->getPriority() < 50 && kernel->currentThread->getID()!=thread->getID()){
+                preemptions++;
                 kernel->currentThread->Yield();
             }
             return true;
@@ -115,20 +154,620 @@ bool Scheduler::CheckAging(Thread *thread)
     return false;
 }
 
+//----------------------------------------------------------------------
+// Scheduler::CheckReadyQueues
+// 	Called by Interrupt::OneTick on every tick, to age the ready 
+//	threads that have waited AgingTicks, and to make the preemptions
+//	ReadyToRun has flagged (with setJump).
+//
+//	The ready threads that can age are kept in agingQueue, a heap in
+//	the order they will, so most ticks only have to look at the front
+//	of it, and a thread goes on or off it in log time; the ready 
+//	queues themselves are only scanned when a thread is due to age 
+//	or to preempt.
+//
+//	Each check also puts every thread on QueueL2 back in its place,
+//	which (as a side effect of how the original scan walked the 
+//	list) moves the first thread of each run of equal priorities to 
+//	the end of the run.  So that the order of L2, and so the
+//	schedule, comes out as before, the checks in which nothing else
+//	happens are passed on to PriorityQueue::Shuffle, which makes the
+//	moves they owe the next time each priority's list is used.
+//----------------------------------------------------------------------
+
+void
+Scheduler::CheckReadyQueues()
+{
+    int now = kernel->stats->totalTicks;
+
+    if (realTimeDue) {
+        realTimeDue = FALSE;
+        SwitchRealTime();
+    }
+    if (!checkAll && (agingQueue->IsEmpty() 
+            || now - agingQueue->Front()->getWaitTime() < AgingTicks)) {
+        QueueL2->Shuffle(1);
+        return;
+    }
+    ScanReadyQueues();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SkipChecks
+// 	Account for "count" calls to CheckReadyQueues that would have 
+//	found nothing due, as Interrupt::SkipTicks skips that many ticks.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SkipChecks(int count)
+{
+    QueueL2->Shuffle(count);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::NextEventTime
+// 	Return the earliest simulated time, no later than "when", at
+//	which CheckReadyQueues could have anything to do but count: a 
+//	thread aging, or a preemption flagged by ReadyToRun.
+//----------------------------------------------------------------------
+
+int
+Scheduler::NextEventTime(int when)
+{
+    if (checkAll || realTimeDue) {
+        return kernel->stats->totalTicks + 1;
+    }
+    if (!agingQueue->IsEmpty()) {
+        when = min(when, agingQueue->Front()->getWaitTime() + AgingTicks);
+    }
+    return when;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::ScanReadyQueues
+// 	Check each ready thread, as Interrupt::OneTick used to on every 
+//	tick: L1 for aging and flagged preemptions, L2 for the same 
+//	(putting each thread back in its place, in case it aged), and L3
+//	for aging.
+//
+//	As before, a thread that ages out of L3 is followed into L2, and 
+//	the walk goes on from where it landed, checking for aging only.
+//	A thread that ages out of L2 ends the walk of L2; the old scan 
+//	went on down L1 from there, putting L1 threads on L2 as well.
+//	Once we yield the CPU, the rest of the scan is stale and is left
+//	to the next tick.
+//----------------------------------------------------------------------
+
+void
+Scheduler::ScanReadyQueues()
+{
+    Thread *t;
+    Thread **inL1 = SortedQueue(QueueL1);
+    int countL1 = QueueL1->NumInList();
+    Thread **inL3;
+    int countL3;
+    bool promoted = FALSE;
+    int before, i;
+
+    checkAll = FALSE;
+    for (i = 0; i < countL1; i++) {
+        t = inL1[i];
+        CheckAging(t);
+        //check if new comming L1 process has smaller burst time
+        //or current thread is in lower layer queue => preempt
+        if(t->getJump() && kernel->currentThread->getID() != t->getID()){
+            kernel->schedLog->Add(SchedPreempt, t->getID(), QueueIdL1);
+            t->setJump(false);
+            checkAll = TRUE;
+            kernel->currentThread->Yield();
+            return;
+        }
+    }
+
+    for (t = QueueL2->Front(); t != NULL; ) {
+        before = preemptions;
+        promoted = CheckAging(t);
+        if (preemptions != before) {
+            checkAll = TRUE;
+            return;
+        }
+        //may change the priority => requeue
+        if(!promoted && t->getID()>=2) {
+            QueueL2->Remove(t);
+            QueueL2->Append(t);
+        }
+        //check if current thread is in lower layer queue => preempt
+        if(t->getJump() && kernel->currentThread->getID() != t->getID()){
+            kernel->schedLog->Add(SchedPreempt, t->getID(), QueueIdL2);
+            t->setJump(false);
+            checkAll = TRUE;
+            kernel->currentThread->Yield();
+            return;
+        }
+        t = promoted ? NULL : QueueL2->Next(t);
+    }
+
+    promoted = FALSE;
+    countL3 = 0;			// L3 only ages, so skip it if 
+    inL3 = NULL;			// no thread is due to
+    if (!agingQueue->IsEmpty() && kernel->stats->totalTicks 
+            - agingQueue->Front()->getWaitTime() >= AgingTicks) {
+        countL3 = QueueL3->NumInList();
+        inL3 = SortedQueue(QueueL3);
+    }
+    for (i = 0; i < countL3; i++) {
+        t = inL3[i];
+        before = preemptions;
+        promoted = CheckAging(t);
+        if (preemptions != before) {
+            checkAll = TRUE;
+            return;
+        }
+        if (promoted) {			// on up L2, from where it landed
+            for (t = QueueL2->Next(t); t != NULL; t = QueueL2->Next(t)) {
+                before = preemptions;
+                promoted = CheckAging(t);
+                if (preemptions != before) {
+                    checkAll = TRUE;
+                    return;
+                }
+                if (promoted) {
+                    break;
+                }
+            }
+            break;
+        }
+    }
+
+    // any preemptions left for the next tick?  (L3 threads never
+    // preempt, and the order doesn't matter here)
+    for (i = 0; i < QueueRT->NumInList(); i++) {
+        checkAll = checkAll || QueueRT->Item(i)->getJump();
+    }
+    for (i = 0; i < QueueL1->NumInList(); i++) {
+        checkAll = checkAll || QueueL1->Item(i)->getJump();
+    }
+    for (t = QueueL2->Front(); t != NULL; t = QueueL2->Next(t)) {
+        checkAll = checkAll || t->getJump();
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SortedQueue
+// 	Fill in scanBuffer with the threads on "queue", in the order
+//	they will run, and return it.  The buffer lasts as long as the 
+//	scheduler, so a scan doesn't allocate; it only grows if a queue
+//	ever holds more threads than it has room for.
+//----------------------------------------------------------------------
+
+Thread **
+Scheduler::SortedQueue(ThreadHeap *queue)
+{
+    if (queue->NumInList() > scanSize) {
+        while (scanSize < queue->NumInList()) {
+            scanSize *= 2;
+        }
+        delete [] scanBuffer;
+        scanBuffer = new Thread *[scanSize];
+    }
+    queue->Sorted(scanBuffer);
+    return scanBuffer;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::RestoreThread
+// 	Put back the aging clock and the preemption flag of a thread 
+//	that a -restore has just put on the ready list (ReadyToRun 
+//	starts its clock at the restored time).
+//----------------------------------------------------------------------
+
+void
+Scheduler::RestoreThread(Thread *thread, int waitTime, bool jump)
+{
+    if (thread->getID() >= 2) {
+        agingQueue->Remove(thread);
+    }
+    thread->setWaitTime(waitTime);
+    thread->setJump(jump);
+    if (thread->getID() >= 2) {
+        agingQueue->Insert(thread);
+    }
+    if (jump) {
+        checkAll = TRUE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::NumReady
+// 	Return how many threads are on the ready queues.
+//----------------------------------------------------------------------
+
+int
+Scheduler::NumReady()
+{
+    return QueueRT->NumInList() + QueueL1->NumInList() 
+        + QueueL2->NumInList() + QueueL3->NumInList();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::ReadyThreads
+// 	Fill in "threads" with the ready threads, in the order
+//	FindNextToRun would pick them if nothing else happened: 
+//	real-time, then L1, L2 and L3.  There must be room for NumReady
+//	of them.
+//----------------------------------------------------------------------
+
+void
+Scheduler::ReadyThreads(Thread **threads)
+{
+    Thread *t;
+    int count = QueueRT->NumInList();
+
+    QueueRT->Sorted(threads);
+    QueueL1->Sorted(threads + count);
+    count += QueueL1->NumInList();
+    for (t = QueueL2->Front(); t != NULL; t = QueueL2->Next(t)) {
+        threads[count++] = t;
+    }
+    QueueL3->Sorted(threads + count);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::TakeMovable
+// 	Take the ready thread that another process could run (IsMovable)
+//	and that would run last here off the ready queues, and return
+//	it; or NULL if there is none.  Called when an idle one asks for
+//	work (see Kernel::BalanceLoad).
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::TakeMovable()
+{
+    int count = NumReady();
+    Thread **ready;
+    Thread *thread;
+    int i;
+
+    if (numMovable == 0) {
+        return NULL;
+    }
+    ready = new Thread *[count];
+    ReadyThreads(ready);
+    for (i = count - 1; !IsMovable(ready[i]); i--) {
+        ;
+    }
+    thread = ready[i];
+    delete [] ready;
+
+    if (QueueL3->IsInList(thread)) {
+        QueueL3->Remove(thread);
+        kernel->schedLog->Add(SchedRemove, thread->getID(), QueueIdL3);
+    } else if (QueueL2->IsInList(thread)) {
+        QueueL2->Remove(thread);
+        kernel->schedLog->Add(SchedRemove, thread->getID(), QueueIdL2);
+    } else {
+        QueueL1->Remove(thread);
+        kernel->schedLog->Add(SchedRemove, thread->getID(), QueueIdL1);
+    }
+    if (thread->getID() >= 2) {
+        agingQueue->Remove(thread);
+    }
+    numMovable--;
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::VRuntimeNow
+// 	Return the virtual runtime of the thread that is running (or 
+//	has just stopped): what it had when it was picked to run, plus
+//	the user ticks it has run since, scaled down by the weight of its
+//	priority (so a thread of twice the weight gets twice the CPU 
+//	before it falls behind).
+//----------------------------------------------------------------------
+
+double
+Scheduler::VRuntimeNow(Thread *thread)
+{
+    int ran = kernel->stats->userTicks - thread->getStartTime();
+
+    return thread->getVRuntime() 
+        + ran * FairNiceWeight / fairWeight[thread->getPriority()];
+}
+
+//----------------------------------------------------------------------
+// Scheduler::KeepRunning
+// 	Return TRUE if the running thread should go on running when it
+//	yields (as on each timer interrupt, or when MP3 preempts it):
+//	it is real-time, and no real-time thread with an earlier deadline
+//	is ready; or, with -fair, it is in L3, nothing is ready in L1 or
+//	L2 (or real-time), and no L3 thread has less virtual runtime than
+//	it now has.  Otherwise, the Yield goes ahead as usual.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::KeepRunning(Thread *thread)
+{
+    if (thread->IsRealTime() && !thread->rtThrottled) {
+        return QueueRT->IsEmpty() 
+            || thread->rtDeadline <= QueueRT->Front()->rtDeadline;
+    }
+    if (!fairShare || thread->getPriority() >= 50 || !QueueRT->IsEmpty()
+            || !QueueL1->IsEmpty() || !QueueL2->IsEmpty() 
+            || QueueL3->IsEmpty()) {
+        return FALSE;
+    }
+    return VRuntimeNow(thread) <= QueueL3->Front()->getVRuntime();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetRealTime
+// 	Make the running thread real-time (the RealTime system call): 
+//	from now on, in each "period" ticks it may run for "budget" of
+//	them, ahead of every thread that isn't real-time, the one with
+//	the earliest deadline (the end of its period) first.  Return
+//	FALSE, and leave it as it was, if that would give the real-time 
+//	threads more than RealTimeMaxLoad of the CPU between them, or the
+//	budget doesn't fit in the period.
+//
+//	A "period" of 0 makes it an ordinary thread again, in the band of
+//	its priority.  Also called that way for a real-time thread that 
+//	is finishing.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::SetRealTime(Thread *thread, int period, int budget)
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+    int nowOSTime = kernel->stats->totalTicks;
+    double load = realTimeLoad;
+
+    ASSERT(thread == kernel->currentThread);
+    if (thread->IsRealTime()) {
+        load -= (double) thread->rtBudget / thread->rtPeriod;
+    }
+    if (period <= 0) {
+        if (thread->IsRealTime()) {
+            realTime->Remove(thread);
+            realTimeLoad = max(load, 0.0);
+            thread->rtPeriod = 0;
+        }
+        (void) kernel->interrupt->SetLevel(oldLevel);
+        return TRUE;
+    }
+    if (budget <= 0 || budget > period 
+            || load + (double) budget / period > RealTimeMaxLoad + 1e-9) {
+        kernel->schedLog->Add(SchedRefused, thread->getID(), period, budget);
+        (void) kernel->interrupt->SetLevel(oldLevel);
+        return FALSE;
+    }
+    if (!thread->IsRealTime()) {
+        realTime->Append(thread);
+    }
+    realTimeLoad = load + (double) budget / period;
+    thread->rtPeriod = period;
+    thread->rtBudget = thread->rtLeft = budget;
+    thread->rtDeadline = nowOSTime + period;
+    thread->rtThrottled = FALSE;
+    thread->setJump(FALSE);
+    budgetFrom = BusyTicks();
+    kernel->schedLog->Add(SchedRealTime, thread->getID(), period, budget);
+    SetAlarm();
+    (void) kernel->interrupt->SetLevel(oldLevel);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::WaitForPeriod
+// 	The running real-time thread gives up what is left of its budget
+//	(it has done its work for this period, or it has run out), and
+//	sleeps until its next period begins (see Release).
+//----------------------------------------------------------------------
+
+void
+Scheduler::WaitForPeriod()
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+    Thread *thread = kernel->currentThread;
+
+    ASSERT(thread->IsRealTime());
+    thread->rtLeft = 0;
+    thread->rtThrottled = TRUE;
+    kernel->schedLog->Add(SchedWait, thread->getID());
+    thread->Sleep(FALSE);
+    (void) kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::ChargeBudget
+// 	Take the ticks the running real-time thread has run since it was
+//	last charged out of its budget.
+//----------------------------------------------------------------------
+
+void
+Scheduler::ChargeBudget(Thread *thread)
+{
+    int now = BusyTicks();
+
+    thread->rtLeft -= now - budgetFrom;
+    budgetFrom = now;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Release
+// 	Start the next period of a real-time thread, whose deadline has
+//	come: it gets its budget back, and a new deadline.  If it was 
+//	still ready or running, it has missed the deadline; if it was
+//	waiting for this period, it is ready again.  (If whole periods
+//	went by, because it was blocked, they are skipped.)
+//----------------------------------------------------------------------
+
+void
+Scheduler::Release(Thread *thread)
+{
+    int nowOSTime = kernel->stats->totalTicks;
+
+    if (thread == kernel->currentThread) {
+        ChargeBudget(thread);
+    }
+    if (thread->getStatus() == READY || thread->getStatus() == RUNNING) {
+        kernel->schedLog->Add(SchedMiss, thread->getID());
+        kernel->stats->numDeadlineMisses++;
+    }
+    while (thread->rtDeadline <= nowOSTime) {
+        thread->rtDeadline += thread->rtPeriod;
+        kernel->stats->numPeriods++;
+    }
+    thread->rtLeft = thread->rtBudget;
+    if (QueueRT->IsInList(thread)) {		// its deadline moved
+        QueueRT->Remove(thread);
+        QueueRT->Insert(thread);
+    }
+    if (thread->rtThrottled) {
+        thread->rtThrottled = FALSE;
+        ReadyToRun(thread);
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetAlarm
+// 	Make sure we are called back (see CallBack) by the time the next
+//	real-time period begins, or the running real-time thread runs out
+//	of budget, whichever is first.  There is no taking back an 
+//	interrupt, so one set for an earlier state of things may still 
+//	come; it just finds nothing to do.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SetAlarm()
+{
+    int now = kernel->stats->totalTicks;
+    Thread *current = kernel->currentThread;
+    int when = -1;
+    ListIterator<Thread *> iter(realTime);
+
+    for (; !iter.IsDone(); iter.Next()) {
+        if (when < 0 || iter.Item()->rtDeadline < when) {
+            when = iter.Item()->rtDeadline;
+        }
+    }
+    if (current->IsRealTime() && current->getStatus() == RUNNING 
+            && !current->rtThrottled) {
+        ChargeBudget(current);
+        when = (when < 0) ? now + current->rtLeft 
+            : min(when, now + current->rtLeft);
+    }
+    if (when < 0) {
+        return;
+    }
+    when = max(when, now + 1);
+    if (alarmAt < 0 || when < alarmAt) {
+        kernel->interrupt->Schedule(this, when - now, RealTimeInt);
+        alarmAt = when;
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::CallBack
+// 	Called by the interrupt hardware at the time SetAlarm asked for:
+//	start the next period of each real-time thread whose deadline has
+//	come, and check whether the running one has used up its budget.
+//	Like any interrupt handler, we can't switch threads here; a 
+//	thread that should take or give up the CPU does so on the next
+//	tick (see SwitchRealTime).
+//----------------------------------------------------------------------
+
+void
+Scheduler::CallBack()
+{
+    int now = kernel->stats->totalTicks;
+    Thread *current = kernel->currentThread;
+    ListIterator<Thread *> iter(realTime);
+
+    if (alarmAt <= now) {
+        alarmAt = -1;
+    }
+    for (; !iter.IsDone(); iter.Next()) {
+        if (iter.Item()->rtDeadline <= now) {
+            Release(iter.Item());
+        }
+    }
+    if (current->IsRealTime() && current->getStatus() == RUNNING) {
+        ChargeBudget(current);
+        if (current->rtLeft <= 0) {
+            realTimeDue = TRUE;
+        }
+    }
+    if (!QueueRT->IsEmpty()) {
+        realTimeDue = TRUE;
+    }
+    SetAlarm();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SwitchRealTime
+// 	Called from CheckReadyQueues once CallBack or ReadyToRun has found
+//	a real-time thread that should take the CPU, or the running one
+//	out of budget.  A thread out of budget waits for its next period;
+//	otherwise we yield, which leaves the running thread be if it 
+//	should go on (see KeepRunning).
+//----------------------------------------------------------------------
+
+void
+Scheduler::SwitchRealTime()
+{
+    Thread *current = kernel->currentThread;
+
+    if (current->IsRealTime()) {
+        ChargeBudget(current);
+        if (current->rtLeft <= 0 && !current->rtThrottled) {
+            kernel->schedLog->Add(SchedOverrun, current->getID());
+            kernel->stats->numOverruns++;
+            WaitForPeriod();
+            return;
+        }
+    }
+    current->Yield();
+}
+
 //----------------------------------------------------------------------
 // Scheduler::Scheduler
 // 	Initialize the list of ready but not running threads.
 //	Initially, no ready threads.
+//
+//	"fair" -- order L3 by weighted virtual runtime instead of round
+//		robin (-fair)
 //----------------------------------------------------------------------
 
-Scheduler::Scheduler()
+Scheduler::Scheduler(bool fair)
 { 
+    QueueRT = new ThreadHeap(DeadlineCmp, ReadyHeap);
+    realTime = new List<Thread *>;
+    realTimeLoad = 0;
+    budgetFrom = 0;
+    alarmAt = -1;
+    realTimeDue = FALSE;
     //MP3
-    QueueL3 = new List<Thread *>; 
+    QueueL3 = new ThreadHeap(fair ? FairCmp : NULL, ReadyHeap);
     toBeDestroyed = NULL;
     //MP3
-    QueueL1 = new SortedList<Thread *>(L1cmp);
-    QueueL2 = new SortedList<Thread *>(L2cmp);
+    QueueL1 = new ThreadHeap(L1Cmp, ReadyHeap);
+    QueueL2 = new PriorityQueue;
+    agingQueue = new ThreadHeap(AgingCmp, AgingHeap);
+    scanSize = 16;			// grown if ever too small
+    scanBuffer = new Thread *[scanSize];
+    checkAll = FALSE;
+    preemptions = 0;
+    numMovable = 0;
+    //-fair
+    fairShare = fair;
+    minVRuntime = 0;
+    fairWeight[FairNicePriority] = FairNiceWeight;
+    for (int p = FairNicePriority + 1; p < 50; p++) {
+        fairWeight[p] = fairWeight[p - 1] * 1.0456;	// 1.25 in 5 steps
+    }
+    for (int p = FairNicePriority - 1; p >= 0; p--) {
+        fairWeight[p] = fairWeight[p + 1] / 1.0456;
+    }
 } 
 
 //----------------------------------------------------------------------
@@ -141,6 +780,10 @@ Scheduler::~Scheduler()
     delete QueueL3;
     delete QueueL2;
     delete QueueL1; 
+    delete QueueRT;
+    delete realTime;
+    delete agingQueue;
+    delete [] scanBuffer;
 } 
 
 //----------------------------------------------------------------------
@@ -154,10 +797,13 @@ Scheduler::~Scheduler()
 void
 Scheduler::ReadyToRun (Thread *thread)
 {
+    ThreadStatus oldStatus = thread->getStatus();
+
     ASSERT(kernel->interrupt->getLevel() == IntOff);
     DEBUG(dbgThread, "Putting thread on ready list: " << thread->getName());
 	//cout << "Putting thread on ready list: " << thread->getName() << endl ;
     thread->setStatus(READY);
+    thread->usage->readySince = kernel->stats->totalTicks;
     //readyList->Append(thread);
 
     //MP3
@@ -166,16 +812,42 @@ Scheduler::ReadyToRun (Thread *thread)
 
     //from now to wait -> record the startwaittime
     thread->setWaitTime(nowOSTime);
+    //real-time: ahead of all the rest, and doesn't age
+    if (thread->IsRealTime()) {
+        QueueRT->Insert(thread);
+        kernel->schedLog->Add(SchedInsert, thread->getID(), QueueIdRT);
+        if (kernel->currentThread != thread) {
+            realTimeDue = TRUE;		// take the CPU on the next tick
+        }
+        return;
+    }
+    if(thread->getID() >= 2){
+        agingQueue->Insert(thread);
+    }
+    if (IsMovable(thread)) {
+        numMovable++;
+    }
     //Insert the comming thread to its queue -> by priority
     if(threadPriority >= 100 && threadPriority <= 149){
         QueueL1->Insert(thread);
-        cout<<"Tick "<< nowOSTime <<": Thread "<<thread->getID()<<" is inserted into queue L1\n";
+        kernel->schedLog->Add(SchedInsert, thread->getID(), QueueIdL1);
     }else if(threadPriority >= 50 && threadPriority <= 99){
-        QueueL2->Insert(thread);
-        cout<<"Tick "<< nowOSTime <<": Thread "<<thread->getID()<<" is inserted into queue L2\n";
+        QueueL2->Append(thread);
+        kernel->schedLog->Add(SchedInsert, thread->getID(), QueueIdL2);
     }else if(threadPriority >= 0 && threadPriority <= 49){
-        QueueL3->Append(thread);
-        cout<<"Tick "<< nowOSTime <<": Thread "<<thread->getID()<<" is inserted into queue L3\n";
+        //-fair: a thread that yielded is charged for its run before it
+        //goes back in line; a new thread starts level with the others,
+        //and one that was blocked gets at most a bounded head start
+        if (fairShare && oldStatus == RUNNING) {
+            thread->setVRuntime(VRuntimeNow(thread));
+        } else if (fairShare && oldStatus == JUST_CREATED) {
+            thread->setVRuntime(max(thread->getVRuntime(), minVRuntime));
+        } else if (fairShare && oldStatus == BLOCKED) {
+            thread->setVRuntime(max(thread->getVRuntime(), 
+                                    minVRuntime - FairSleeperCredit));
+        }
+        QueueL3->Insert(thread);
+        kernel->schedLog->Add(SchedInsert, thread->getID(), QueueIdL3);
     }else{  //wrong priority
         cout<<"Priority out of legal range.\n";
     }
@@ -185,7 +857,7 @@ Scheduler::ReadyToRun (Thread *thread)
     if(kernel->currentThread->getID() != thread->getID() && kernel->currentThread->getID()>=2){
         if(threadPriority >= 100){
             if(kernel->currentThread->getPriority()>=100){
-                cout<<"ReadyToRun! Two process are in L1: compare the burst time"<<endl;
+                kernel->schedLog->Add(SchedCompare, thread->getID(), FALSE);
                 //double actualBT = kernel->stats->userTicks - kernel->currentThread->getStartTime();
                 //double estiBT = 0.5 * actualBT + 0.5 * kernel->currentThread->getBurstTime();
                 /*
@@ -194,10 +866,8 @@ Scheduler::ReadyToRun (Thread *thread)
                     So here, just use previous time's burst time to do comparison!
                 */
                 if(thread->getBurstTime() < kernel->currentThread->getBurstTime()){
-                    cout<<"\nThread: "<<thread->getID()<<" burst time = "<<thread->getBurstTime()<<endl;
-                    cout<<"Current Thread: "<<kernel->currentThread->getID()<<" burst time = "<<kernel->currentThread->getBurstTime()<<endl;
-                    cout<<"Since new Thread "<<thread->getID()<<" has smaller burst time, ";
-                    cout<<"preempt the currentThread\n\n";
+                    kernel->schedLog->AddBurst(thread->getID(), thread->getBurstTime(),
+                        kernel->currentThread->getID(), kernel->currentThread->getBurstTime());
                     //kernel->currentThread->Yield();
                     thread->setJump(true);
                 }
@@ -210,7 +880,66 @@ Scheduler::ReadyToRun (Thread *thread)
             thread->setJump(true);
         }
     }
-    
+    if(thread->getJump()){
+        checkAll = TRUE;        //preempt on the next tick
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetInherited
+// 	Change the priority a thread inherits from the threads waiting for
+//	its locks (see Lock::Acquire).  If it is ready, and that changes 
+//	the queue it belongs in (or its place in L2), move it there.
+//	The change is only logged with -d s, so that the usual trace is 
+//	the same as without priority inheritance.
+//
+//	"priority" -- the highest priority of those threads, or -1
+//----------------------------------------------------------------------
+
+void
+Scheduler::SetInherited(Thread *thread, int priority)
+{
+    int oldPriority = thread->getPriority();
+    int newPriority;
+    SchedQueue from, to;
+
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    thread->setInherited(priority);
+    newPriority = thread->getPriority();
+    if (newPriority == oldPriority) {
+        return;
+    }
+    if (debug->IsEnabled(dbgSynch)) {
+        kernel->schedLog->Add(SchedPriority, thread->getID(), oldPriority, 
+                              newPriority);
+    }
+    if (thread->getStatus() != READY || thread->IsRealTime()) {
+        return;			// ReadyToRun will queue it by priority
+    }
+    from = (oldPriority >= 100) ? QueueIdL1 
+           : (oldPriority >= 50) ? QueueIdL2 : QueueIdL3;
+    to = (newPriority >= 100) ? QueueIdL1 
+         : (newPriority >= 50) ? QueueIdL2 : QueueIdL3;
+    if (from == to && to != QueueIdL2) {
+        return;			// L1 and L3 don't go by priority
+    }
+    if (from == QueueIdL1) {
+        QueueL1->Remove(thread);
+    } else if (from == QueueIdL2) {
+        QueueL2->Remove(thread);
+    } else {
+        QueueL3->Remove(thread);
+    }
+    if (to == QueueIdL1) {
+        QueueL1->Insert(thread);
+    } else if (to == QueueIdL2) {
+        QueueL2->Append(thread);
+    } else {
+        QueueL3->Insert(thread);
+    }
+    if (from != to) {
+        kernel->schedLog->Add(SchedPromote, thread->getID(), from, to);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -233,20 +962,34 @@ Scheduler::FindNextToRun ()
     }*/
 
     //MP3
-    int nowOSTime = kernel->stats->totalTicks;
+    Thread *next;
 
+    if (!QueueRT->IsEmpty()) {
+        kernel->schedLog->Add(SchedRemove, QueueRT->Front()->getID(), QueueIdRT);
+        return QueueRT->RemoveFront();
+    }
     if(!QueueL1->IsEmpty()){
-        cout<<"Tick "<< nowOSTime <<": Thread "<< QueueL1->Front()->getID() <<" is removed from queue L1\n";
-        return QueueL1->RemoveFront();
+        kernel->schedLog->Add(SchedRemove, QueueL1->Front()->getID(), QueueIdL1);
+        next = QueueL1->RemoveFront();
     }else if(!QueueL2->IsEmpty()){
-        cout<<"Tick "<< nowOSTime <<": Thread "<< QueueL2->Front()->getID() <<" is removed from queue L2\n";
-        return QueueL2->RemoveFront();
+        kernel->schedLog->Add(SchedRemove, QueueL2->Front()->getID(), QueueIdL2);
+        next = QueueL2->RemoveFront();
     }else if(!QueueL3->IsEmpty()){
-        cout<<"Tick "<< nowOSTime <<": Thread "<< QueueL3->Front()->getID() <<" is removed from queue L3\n";
-        return QueueL3->RemoveFront();
+        kernel->schedLog->Add(SchedRemove, QueueL3->Front()->getID(), QueueIdL3);
+        next = QueueL3->RemoveFront();
+        if (fairShare) {
+            minVRuntime = max(minVRuntime, next->getVRuntime());
+        }
     }else{
         return NULL;
     }
+    if(next->getID() >= 2){
+        agingQueue->Remove(next);
+    }
+    if (IsMovable(next)) {
+        numMovable--;
+    }
+    return next;
 
 }
 
@@ -272,26 +1015,41 @@ Scheduler::Run (Thread *nextThread, bool finishing)
 {
     Thread *oldThread = kernel->currentThread;
     //MP3
-    int nowOSTime = kernel->stats->totalTicks;
     int nowUserTime = kernel->stats->userTicks;
     int oldThreadTime = nowUserTime - oldThread->getStartTime();
+    if (fairShare && oldThread->getPriority() < 50 
+            && oldThread->getStatus() != READY) {	// else ReadyToRun
+        oldThread->setVRuntime(VRuntimeNow(oldThread));	// charged it
+    }
     nextThread->setStartTime(nowUserTime);
+    nextThread->usage->readyTicks += 
+        kernel->stats->totalTicks - nextThread->usage->readySince;
     
     //MP3: context switch msg
-    cout<<"Tick "<< nowOSTime <<": Thread "<<nextThread->getID()<<" is now selected for execution\n";
-    cout<<"Tick "<< nowOSTime <<": Thread "<<oldThread->getID()<<" is replaced, and it has executed "
-        <<oldThreadTime<<" ticks\n";
+    kernel->schedLog->Add(SchedSelect, nextThread->getID());
+    kernel->schedLog->Add(SchedReplace, oldThread->getID(), oldThreadTime);
     
     ASSERT(kernel->interrupt->getLevel() == IntOff);
 
+    if (oldThread->IsRealTime()) {
+        ChargeBudget(oldThread);
+    }
     if (finishing) {	// mark that we need to delete current thread
          ASSERT(toBeDestroyed == NULL);
 	 toBeDestroyed = oldThread;
+	 if (oldThread->IsRealTime()) {		// free its share
+	     (void) SetRealTime(oldThread, 0, 0);
+	 }
     }
     
-    if (oldThread->space != NULL) {	// if this thread is a user program,
-        oldThread->SaveUserState(); 	// save the user's CPU registers
-	oldThread->space->SaveState();
+    // A user program's registers and address space stay in the machine
+    // until some other program needs it (see Thread::ClaimUserRegisters
+    // and AddrSpace::RestoreState); if it runs next, or only kernel
+    // threads do, nothing need be saved or restored.
+    if (nextThread->space != NULL && !nextThread->space->IsLoaded()) {
+	kernel->stats->numFullSwitches++;
+    } else {
+	kernel->stats->numLightSwitches++;
     }
     
     oldThread->CheckOverflow();		    // check if the old thread
@@ -299,6 +1057,10 @@ Scheduler::Run (Thread *nextThread, bool finishing)
 
     kernel->currentThread = nextThread;  // switch to the next thread
     nextThread->setStatus(RUNNING);      // nextThread is now running
+    if (nextThread->IsRealTime()) {	    // its budget starts running
+        budgetFrom = BusyTicks();	    // out
+        SetAlarm();
+    }
     
     DEBUG(dbgThread, "Switching from: " << oldThread->getName() << " to: " << nextThread->getName());
     
@@ -322,7 +1084,8 @@ Scheduler::Run (Thread *nextThread, bool finishing)
     
     if (oldThread->space != NULL) {	    // if there is an address space
         oldThread->RestoreUserState();     // to restore, do it.
-	oldThread->space->RestoreState();
+	if (!oldThread->space->IsLoaded())
+	    oldThread->space->RestoreState();
     }
 }
 
@@ -351,6 +1114,12 @@ Scheduler::CheckToBeDestroyed()
 void
 Scheduler::Print()
 {
+    Thread **inL3 = new Thread *[QueueL3->NumInList()];
+
     cout << "Ready list contents:\n";
-    QueueL3->Apply(ThreadPrint);
+    QueueL3->Sorted(inL3);
+    for (int i = 0; i < QueueL3->NumInList(); i++) {
+        ThreadPrint(inL3[i]);
+    }
+    delete [] inL3;
 }
@@ -12,14 +12,38 @@
 #include "copyright.h"
 #include "list.h"
 #include "thread.h"
+#include "runqueue.h"
+#include "stats.h"
+#include "callback.h"
+
+//MP3: a ready thread gains 10 priority each time it has waited this long
+const int AgingTicks = 1500;
+
+//-fair: an L3 thread of this priority has weight FairNiceWeight, and
+// each priority above (below) it has about 1.25 times the weight of the
+// one five below (above) it; a thread that has been blocked comes back
+// no more than FairSleeperCredit behind the least virtual runtime
+const int FairNicePriority = 25;
+const int FairNiceWeight = 1024;
+const int FairSleeperCredit = TimerTicks;
+
+// real-time threads are admitted as long as, together, their budgets
+// take up no more than this share of the CPU (which EDF can then meet)
+const double RealTimeMaxLoad = 1.0;
 
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
 // thread is running, and which threads are ready but not running.
+//
+// The scheduler is also a device of sorts: it has the interrupt
+// hardware call it back when a real-time thread's period ends or its
+// budget runs out.
 
-class Scheduler {
+class Scheduler : public CallBackObj {
   public:
-    Scheduler();		// Initialize list of ready threads 
+    Scheduler(bool fair);	// Initialize list of ready threads;
+				// with "fair", L3 shares the CPU by
+				// weighted virtual runtime (-fair)
     ~Scheduler();		// De-allocate ready list
 
     void ReadyToRun(Thread* thread);	
@@ -36,14 +60,81 @@ class Scheduler {
 
     //MP3
     bool CheckAging(Thread *thread);
-    List<Thread *> *QueueL3;  // queue of threads that are ready to run,
-                // but not running
-    //MP3
-    SortedList<Thread *> *QueueL1;
-    SortedList<Thread *> *QueueL2;
+    void CheckReadyQueues();	// age threads and make flagged 
+				// preemptions, on each OneTick
+    void SkipChecks(int count);	// as "count" calls to CheckReadyQueues
+				// with nothing to do (see SkipTicks)
+    int NextEventTime(int when);	// when CheckReadyQueues next
+				// has work to do
+    void RestoreThread(Thread *thread, int waitTime, bool jump);
+				// give a thread from a -restore its
+				// aging clock and preemption flag
+    int NumReady();		// how many threads are ready
+    void ReadyThreads(Thread **threads);
+				// fill in the ready threads, real-time,
+				// L1, L2 then L3, each in the order it
+				// will run
+    int NumMovable() { return numMovable; }
+				// how many ready threads could move to 
+				// another Nachos process (-procs)
+    Thread *TakeMovable();	// take one of them off the ready queues
+    bool KeepRunning(Thread *thread);
+				// should a Yield by the running thread 
+				// leave it running? (-fair, real-time)
+    void SetInherited(Thread *thread, int priority);
+				// lend a thread the priority of those 
+				// waiting for its locks, and requeue it
+
+    bool SetRealTime(Thread *thread, int period, int budget);
+				// make the running thread real-time, if
+				// there is room for it
+    void WaitForPeriod();	// the running real-time thread is done
+				// until its next period
+    void CallBack();		// a real-time period ends, or the budget
+				// of the one running runs out
     
   private:
-    
+    ThreadHeap *QueueRT;	// real-time, earliest deadline first
+    List<Thread *> *realTime;	// all the real-time threads
+    double realTimeLoad;	// the share of the CPU they may take
+    int budgetFrom;		// when the budget of the running thread
+				// was last charged
+    int alarmAt;		// when the next RealTimeInt is due, or -1
+    bool realTimeDue;		// a real-time thread has to take (or 
+				// give up) the CPU, on the next tick
+    //MP3
+    ThreadHeap *QueueL1;	// priority 100-149, shortest burst first
+    PriorityQueue *QueueL2;	// priority 50-99, highest first
+    ThreadHeap *QueueL3;	// priority 0-49, round robin, or with 
+				// -fair least virtual runtime first
+    ThreadHeap *agingQueue;	// the ready threads that can age,
+				// the first one due at the front
+    bool checkAll;		// a ready thread may have to preempt
+    int preemptions;		// Yields made by the checks so far
+    int numMovable;		// ready threads that haven't run yet,
+				// and aren't tied to this process
+
+    bool fairShare;		// L3 is the fair class (-fair)
+    double fairWeight[50];	// the weight of each L3 priority
+    double minVRuntime;		// least virtual runtime of an L3 thread
+				// that has run, never going back
+
+    void ScanReadyQueues();	// what CheckReadyQueues does when 
+				// something is due
+    Thread **scanBuffer;	// where ScanReadyQueues sorts L1 and
+    int scanSize;		// L3, and how many it holds
+    Thread **SortedQueue(ThreadHeap *queue);
+				// sort a queue into scanBuffer
+    double VRuntimeNow(Thread *thread);
+				// its virtual runtime, counting the
+				// ticks it has run since it was picked
+    void ChargeBudget(Thread *thread);
+				// for the ticks it has run since
+    void Release(Thread *thread);	// start its next period
+    void SetAlarm();		// make sure the scheduler gets called 
+				// back for the next period or overrun
+    void SwitchRealTime();	// what CheckReadyQueues does when 
+				// realTimeDue
 
     Thread *toBeDestroyed;	// finishing thread to be destroyed
     				// by the next thread that runs
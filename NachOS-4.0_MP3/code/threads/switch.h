@@ -128,7 +128,7 @@
 
 #endif 	// PARISC
 
-#ifdef x86
+#if defined(x86) && !defined(__x86_64__)
 
 /* the offsets of the registers from the beginning of the thread object */
 #define _ESP     0
@@ -154,7 +154,37 @@
 #define WhenDonePC      %edi
 #define StartupPC       %ecx
 
-#endif // x86
+#endif // x86 && !__x86_64__
+
+#if defined(x86) && defined(__x86_64__)
+
+/* A native 64-bit build (no -m32).  Pointers, and so the slots in
+ * machineState, are 8 bytes wide.  Only the callee-saved registers
+ * need to be kept across SWITCH; the rest are dead at a call.
+ */
+#define _RSP     0
+#define _RBX     8
+#define _RBP     16
+#define _R12     24
+#define _R13     32
+#define _R14     40
+#define _R15     48
+#define _PC      56
+
+/* These definitions are used in Thread::AllocateStack(). */
+#define PCState         (_PC/8-1)
+#define FPState         (_RBP/8-1)
+#define InitialPCState  (_R12/8-1)
+#define InitialArgState (_R13/8-1)
+#define WhenDonePCState (_R14/8-1)
+#define StartupPCState  (_R15/8-1)
+
+#define InitialPC       %r12
+#define InitialArg      %r13
+#define WhenDonePC      %r14
+#define StartupPC       %r15
+
+#endif // x86 && __x86_64__
 
 #ifdef PowerPC 
 
@@ -160,6 +160,9 @@ Lock::Lock(char* debugName)
     name = debugName;
     semaphore = new Semaphore("lock", 1);  // initially, unlocked
     lockHolder = NULL;
+    waiters = new List<Thread *>;
+    highestWaiter = -1;
+    nextHeld = NULL;
 }
 
 //----------------------------------------------------------------------
@@ -169,6 +172,7 @@ Lock::Lock(char* debugName)
 Lock::~Lock()
 {
     delete semaphore;
+    delete waiters;
 }
 
 //----------------------------------------------------------------------
@@ -176,12 +180,55 @@ Lock::~Lock()
 //	Atomically wait until the lock is free, then set it to busy.
 //	Equivalent to Semaphore::P(), with the semaphore value of 0
 //	equal to busy, and semaphore value of 1 equal to free.
+//
+//	While we wait, the holder runs with our priority if that is
+//	higher than its own -- and so does the holder of any lock it is
+//	waiting for, and so on down the chain.  Once we have the lock,
+//	we take over the priority of those still waiting.
+//
+//	Each lock down the chain has a waiter (us, or the holder of the
+//	lock before) with our priority, so its highestWaiter is raised
+//	to match.  A waiter's priority only rises while it waits, so
+//	that keeps highestWaiter right without looking at the others.
 //----------------------------------------------------------------------
 
 void Lock::Acquire()
 {
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+    Thread *thread = kernel->currentThread;
+    int priority = thread->getPriority();
+    int waitFrom = kernel->stats->totalTicks;
+
+    if (lockHolder != NULL) {
+	thread->waitingFor = this;
+	waiters->Append(thread);
+	for (Lock *lock = this; lock != NULL && lock->lockHolder != NULL;
+		lock = lock->lockHolder->waitingFor) {
+	    if (priority > lock->highestWaiter) {
+		lock->highestWaiter = priority;
+	    }
+	    if (lock->lockHolder->getPriority() >= priority) {
+		break;
+	    }
+	    kernel->scheduler->SetInherited(lock->lockHolder, priority);
+	}
+    }
     semaphore->P();
-    lockHolder = kernel->currentThread;
+    if (thread->waitingFor != NULL) {
+	waiters->Remove(thread);
+	if (thread->getPriority() >= highestWaiter) {
+	    FindHighestWaiter();	// we may have been the highest
+	}
+	thread->waitingFor = NULL;
+	thread->usage->lockTicks += kernel->stats->totalTicks - waitFrom;
+    }
+    lockHolder = thread;
+    nextHeld = thread->locksHeld;
+    thread->locksHeld = this;
+    if (HighestWaiter() > thread->getInherited()) {
+	kernel->scheduler->SetInherited(thread, HighestWaiter());
+    }
+    (void) kernel->interrupt->SetLevel(oldLevel);
 }
 
 //----------------------------------------------------------------------
@@ -197,9 +244,46 @@ void Lock::Acquire()
 
 void Lock::Release()
 {
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+    Thread *thread = kernel->currentThread;
+    Lock **held;
+    int inherited = -1;
+
     ASSERT(IsHeldByCurrentThread());
+    for (held = &thread->locksHeld; *held != this; held = &(*held)->nextHeld)
+	;
+    *held = nextHeld;
     lockHolder = NULL;
+    for (Lock *lock = thread->locksHeld; lock != NULL; lock = lock->nextHeld) {
+	if (lock->HighestWaiter() > inherited) {
+	    inherited = lock->HighestWaiter();
+	}
+    }
+    if (inherited != thread->getInherited()) {	// keep only what our
+	kernel->scheduler->SetInherited(thread, inherited);	// other
+    }							// locks lend us
     semaphore->V();
+    (void) kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Lock::FindHighestWaiter
+//	Set highestWaiter to the highest priority of a thread waiting to
+//	acquire the lock (counting what it inherits in turn), or -1 if 
+//	none is.  Only needed when the waiter that had it stops waiting;
+//	Acquire keeps it up to date otherwise.
+//----------------------------------------------------------------------
+
+void Lock::FindHighestWaiter()
+{
+    ListIterator<Thread *> iter(waiters);
+
+    highestWaiter = -1;
+    for (; !iter.IsDone(); iter.Next()) {
+	if (iter.Item()->getPriority() > highestWaiter) {
+	    highestWaiter = iter.Item()->getPriority();
+	}
+    }
 }
 
 //----------------------------------------------------------------------
@@ -65,6 +65,11 @@ class Semaphore {
 // In addition, by convention, only the thread that acquired the lock
 // may release it.  As with semaphores, you can't read the lock value
 // (because the value might change immediately after you read it).  
+//
+// A thread waiting in Acquire lends its priority to the holder, and to
+// whatever thread the holder is itself waiting for, and so on, until
+// the lock is released; so a low priority thread holding a lock can't
+// keep a high priority one waiting behind the threads in between.
 
 class Lock {
   public:
@@ -86,6 +91,13 @@ class Lock {
     char *name;			// debugging assist
     Thread *lockHolder;		// thread currently holding lock
     Semaphore *semaphore;	// we use a semaphore to implement lock
+    List<Thread *> *waiters;	// threads waiting in Acquire
+    int highestWaiter;		// the highest priority of one, or -1
+    Lock *nextHeld;		// the next lock the holder holds
+
+    int HighestWaiter() { return highestWaiter; }
+    void FindHighestWaiter();	// work highestWaiter out again, when
+				// the waiter that had it leaves
 };
 
 // The following class defines a "condition variable".  A condition
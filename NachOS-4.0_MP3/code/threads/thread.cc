@@ -25,6 +25,19 @@
 // this is put at the top of the execution stack, for detecting stack overflows
 const int STACK_FENCEPOST = 0xdedbeef;
 
+// Finished threads, and their stacks, kept for new threads to reuse --
+// up to kernel->threadPoolSize of each.  A stack is kept with its guard
+// pages still in place, so a thread that reuses one costs no calls to
+// the host at all.
+static void **freeThreads = NULL;
+static int numFreeThreads = 0;
+static int **freeStacks = NULL;
+static int numFreeStacks = 0;
+
+// The thread whose user registers the machine holds, not yet saved in 
+// its userRegisters, or NULL.
+static Thread *registersOf = NULL;
+
 //----------------------------------------------------------------------
 // Thread::Thread
 // 	Initialize a thread control block, so that we can then call
@@ -37,6 +50,7 @@ Thread::Thread(char* threadName, int threadID)
 {
 	ID = threadID;
     name = threadName;
+    priority = 0;
     stackTop = NULL;
     stack = NULL;
     status = JUST_CREATED;
@@ -46,7 +60,20 @@ Thread::Thread(char* threadName, int threadID)
 					// of machine registers
     }
     burstTime = 0;
+    userLevel = FALSE;
+    readyNext = readyPrev = NULL;
+    readyLevel = -1;
+    readyIndex[ReadyHeap] = readyIndex[AgingHeap] = -1;
+    vruntime = 0;
+    rtPeriod = rtBudget = rtLeft = rtDeadline = 0;
+    rtThrottled = FALSE;
+    inherited = -1;
+    waitingFor = NULL;
+    locksHeld = NULL;
+    affinity = -1;
+    hasRun = FALSE;
     space = NULL;
+    usage = kernel->stats->AddThread(threadID, threadName);
 }
 Thread::Thread(char* threadName, int threadID, int P)
 {
@@ -66,7 +93,20 @@ Thread::Thread(char* threadName, int threadID, int P)
     //first guess bursttime: 0
     burstTime = 0;
     jump = false;
+    userLevel = FALSE;
+    readyNext = readyPrev = NULL;
+    readyLevel = -1;
+    readyIndex[ReadyHeap] = readyIndex[AgingHeap] = -1;
+    vruntime = 0;
+    rtPeriod = rtBudget = rtLeft = rtDeadline = 0;
+    rtThrottled = FALSE;
+    inherited = -1;
+    waitingFor = NULL;
+    locksHeld = NULL;
+    affinity = -1;
+    hasRun = FALSE;
     space = NULL;
+    usage = kernel->stats->AddThread(threadID, threadName);
 }
 //----------------------------------------------------------------------
 // Thread::~Thread
@@ -84,8 +124,50 @@ Thread::~Thread()
 {
     DEBUG(dbgThread, "Deleting thread: " << name);
     ASSERT(this != kernel->currentThread);
-    if (stack != NULL)
+    if (registersOf == this)
+	registersOf = NULL;		// no need to save them now
+    if (stack == NULL)
+	return;
+    if (numFreeStacks < kernel->threadPoolSize) {
+	if (freeStacks == NULL)
+	    freeStacks = new int *[kernel->threadPoolSize];
+	freeStacks[numFreeStacks++] = stack;
+    } else {
 	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+    }
+}
+
+//----------------------------------------------------------------------
+// Thread::operator new
+// 	Allocate a thread control block, reusing that of a finished 
+//	thread if one has been kept.
+//----------------------------------------------------------------------
+
+void *
+Thread::operator new(size_t size)
+{
+    ASSERT(size == sizeof(Thread));
+    if (numFreeThreads > 0)
+	return freeThreads[--numFreeThreads];
+    return ::operator new(size);
+}
+
+//----------------------------------------------------------------------
+// Thread::operator delete
+// 	Free a thread control block, or if there is room, keep it for
+//	the next thread to reuse.
+//----------------------------------------------------------------------
+
+void
+Thread::operator delete(void *p)
+{
+    if (numFreeThreads < kernel->threadPoolSize) {
+	if (freeThreads == NULL)
+	    freeThreads = new void *[kernel->threadPoolSize];
+	freeThreads[numFreeThreads++] = p;
+    } else {
+	::operator delete(p);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -115,7 +197,7 @@ Thread::Fork(VoidFunctionPtr func, void *arg)
     Scheduler *scheduler = kernel->scheduler;
     IntStatus oldLevel;
     
-    DEBUG(dbgThread, "Forking thread: " << name << " f(a): " << (int) func << " " << arg);
+    DEBUG(dbgThread, "Forking thread: " << name << " f(a): " << (void *) func << " " << arg);
     StackAllocate(func, arg);
 
     oldLevel = interrupt->SetLevel(IntOff);
@@ -168,6 +250,7 @@ Thread::Begin ()
 {
     ASSERT(this == kernel->currentThread);
     DEBUG(dbgThread, "Beginning thread: " << name);
+    hasRun = TRUE;
     
     kernel->scheduler->CheckToBeDestroyed();
     kernel->interrupt->Enable();
@@ -226,6 +309,10 @@ Thread::Yield ()
     ASSERT(this == kernel->currentThread);
     
     DEBUG(dbgThread, "Yielding thread: " << name);
+    if (kernel->scheduler->KeepRunning(this)) {	// -fair: still owed
+	(void) kernel->interrupt->SetLevel(oldLevel);	// the CPU
+	return;
+    }
     /*
     MP3
     12/16 modified: Yield is preemptive operation => need not to update burst time
@@ -239,6 +326,7 @@ Thread::Yield ()
 
     nextThread = kernel->scheduler->FindNextToRun();
     if (nextThread != NULL) {
+	   usage->numInvoluntarySwitches++;
 	   kernel->scheduler->ReadyToRun(this);
 	   kernel->scheduler->Run(nextThread, FALSE);
     }
@@ -276,6 +364,7 @@ Thread::Sleep (bool finishing)
     DEBUG(dbgThread, "Sleeping thread: " << name);
 
     status = BLOCKED;
+    usage->numVoluntarySwitches++;
     /*
     MP3
     12/16 modified: the "only" function that can update burst time
@@ -338,6 +427,8 @@ PLabelToAddr(void *plabel)
 //		calls (*func)(arg)
 //		calls Thread::Finish
 //
+//	The stack of a finished thread is reused, if one has been kept.
+//
 //	"func" is the procedure to be forked
 //	"arg" is the parameter to be passed to the procedure
 //----------------------------------------------------------------------
@@ -345,7 +436,10 @@ PLabelToAddr(void *plabel)
 void
 Thread::StackAllocate (VoidFunctionPtr func, void *arg)
 {
-    stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
+    if (numFreeStacks > 0)
+	stack = freeStacks[--numFreeStacks];
+    else
+	stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
 
 #ifdef PARISC
     // HP stack works from low addresses to high addresses
@@ -381,8 +475,10 @@ Thread::StackAllocate (VoidFunctionPtr func, void *arg)
     // the x86 passes the return address on the stack.  In order for SWITCH() 
     // to go to ThreadRoot when we switch to this thread, the return addres 
     // used in SWITCH() must be the starting address of ThreadRoot.
+    // The slot is as wide as a pointer, so this works on x86-64 too.
     stackTop = stack + StackSize - 4;	// -4 to be on the safe side!
-    *(--stackTop) = (int) ThreadRoot;
+    stackTop -= sizeof(void *) / sizeof(int);
+    *(void **) stackTop = (void *) ThreadRoot;
     *stack = STACK_FENCEPOST;
 #endif
     
@@ -426,15 +522,97 @@ Thread::SaveUserState()
 //	Note that a user program thread has *two* sets of CPU registers -- 
 //	one for its state while executing user code, one for its state 
 //	while executing kernel code.  This routine restores the former.
+//
+//	A thread's registers are only saved once another thread needs
+//	the machine's; until then, there is nothing to restore.
 //----------------------------------------------------------------------
 
 void
 Thread::RestoreUserState()
 {
+    if (registersOf == this)
+	return;				// never left the machine
+    ClaimUserRegisters();
     for (int i = 0; i < NumTotalRegs; i++)
 	kernel->machine->WriteRegister(i, userRegisters[i]);
 }
 
+//----------------------------------------------------------------------
+// Thread::ClaimUserRegisters
+//	Make the machine's user registers ours to overwrite: if another
+//	thread's state is still in them, save it first.
+//----------------------------------------------------------------------
+
+void
+Thread::ClaimUserRegisters()
+{
+    if (registersOf != NULL && registersOf != this)
+	registersOf->SaveUserState();
+    registersOf = this;
+}
+
+//----------------------------------------------------------------------
+// Thread::Checkpoint
+//	Write what it takes to re-create this thread to a checkpoint
+//	file (see Kernel::Checkpoint): its name and id, its scheduling
+//	state, and its user registers.  Only a user program thread that
+//	was stopped while running user code can be re-created this way;
+//	its kernel stack has nothing on it but Machine::Run.
+//
+//	"fd" -- the open checkpoint file
+//----------------------------------------------------------------------
+
+void
+Thread::Checkpoint(int fd)
+{
+    int length = strlen(name) + 1;
+
+    ASSERT(space != NULL && userLevel);
+    if (this == kernel->currentThread)
+	SaveUserState();		// its registers are in the machine
+    WriteFile(fd, (char *) &ID, sizeof(int));
+    WriteFile(fd, (char *) &length, sizeof(int));
+    WriteFile(fd, name, length);
+    WriteFile(fd, (char *) &priority, sizeof(int));
+    WriteFile(fd, (char *) &burstTime, sizeof(double));
+    WriteFile(fd, (char *) &waitTime, sizeof(int));
+    WriteFile(fd, (char *) &jump, sizeof(bool));
+    WriteFile(fd, (char *) &thisTimeBurstTime, sizeof(double));
+    WriteFile(fd, (char *) &vruntime, sizeof(double));
+    WriteFile(fd, (char *) userRegisters, sizeof(userRegisters));
+}
+
+//----------------------------------------------------------------------
+// Thread::Restore
+//	Re-create a thread from what Thread::Checkpoint wrote.  The new
+//	thread has its old user registers, but no address space and no
+//	stack yet; the caller gives it those, and forks it to run
+//	user code from where it left off.
+//
+//	"fd" -- the open checkpoint file
+//----------------------------------------------------------------------
+
+Thread *
+Thread::Restore(int fd)
+{
+    Thread *thread;
+    char *threadName;
+    int threadID, length, p;
+
+    Read(fd, (char *) &threadID, sizeof(int));
+    Read(fd, (char *) &length, sizeof(int));
+    threadName = new char[length];
+    Read(fd, threadName, length);
+    Read(fd, (char *) &p, sizeof(int));
+    thread = new Thread(threadName, threadID, p);
+    Read(fd, (char *) &thread->burstTime, sizeof(double));
+    Read(fd, (char *) &thread->waitTime, sizeof(int));
+    Read(fd, (char *) &thread->jump, sizeof(bool));
+    Read(fd, (char *) &thread->thisTimeBurstTime, sizeof(double));
+    Read(fd, (char *) &thread->vruntime, sizeof(double));
+    Read(fd, (char *) thread->userRegisters, sizeof(userRegisters));
+    return thread;
+}
 
 //----------------------------------------------------------------------
 // SimpleThread
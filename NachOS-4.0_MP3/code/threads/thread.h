@@ -42,6 +42,9 @@
 #include "sysdep.h"
 #include "machine.h"
 #include "addrspace.h"
+#include "stats.h"
+
+class Lock;
 
 // CPU register state to be saved on context switch.  
 // The x86 needs to save only a few registers, 
@@ -57,10 +60,19 @@
 // WATCH OUT IF THIS ISN'T BIG ENOUGH!!!!!
 const int StackSize = (8 * 1024);	// in words
 
+// How many finished threads, and their stacks, are kept for the next
+// threads created to reuse, unless -tpool says otherwise.
+const int ThreadPoolSize = 16;
+
 
 // Thread state
 enum ThreadStatus { JUST_CREATED, RUNNING, READY, BLOCKED, ZOMBIE };
 
+// The kinds of ThreadHeap (see runqueue.h).  A thread can be on one 
+// heap of each kind at once: a ready queue, and the scheduler's queue
+// of ready threads waiting to age.
+enum HeapKind { ReadyHeap, AgingHeap, NumHeapKinds };
+
 
 // The following class defines a "thread control block" -- which
 // represents a single thread of execution.
@@ -87,6 +99,10 @@ class Thread {
 					// NOTE -- thread being deleted
 					// must not be running when delete 
 					// is called
+    static void *operator new(size_t size);
+				// reuse a finished thread, if one is kept
+    static void operator delete(void *p);
+				// keep a finished thread, if there is room
 
     // basic thread operations
 
@@ -107,9 +123,14 @@ class Thread {
 	int getID() { return (ID); }
     void Print() { cout << name; }
     void SelfTest();		// test whether thread impl is working
-    //MP3: attributes getter/setter
-    int getPriority(){ return priority; }
+    //MP3: attributes getter/setter; the priority it is scheduled by is
+    //its own, or one it inherits while it holds a lock a thread with a
+    //higher priority is waiting for (see Lock::Acquire)
+    int getPriority(){ return (inherited > priority) ? inherited : priority; }
+    int getOwnPriority(){ return priority; }
     void setPriority(int p){ priority = p; }
+    int getInherited(){ return inherited; }
+    void setInherited(int p){ inherited = p; }
     int getStartTime(){ return startTime; }
     void setStartTime(int s){ startTime = s; }
     double getBurstTime(){ return burstTime; }
@@ -118,20 +139,64 @@ class Thread {
     void setWaitTime(int w){ waitTime = w; }
     void setJump(bool b){ jump = b; }
     bool getJump() { return jump; }
+    //-fair: user ticks run, scaled by weight (see Scheduler::VRuntimeNow)
+    double getVRuntime() { return vruntime; }
+    void setVRuntime(double v) { vruntime = v; }
     //12/16 modified
     void setThisTimeBurstTime(double t) { thisTimeBurstTime = t; }
     double getThisTimeBurstTime() { return thisTimeBurstTime; }
+    //running user code, rather than the kernel on its behalf?
+    void setUserLevel(bool u) { userLevel = u; }
+    bool getUserLevel() { return userLevel; }
+    //MP3: where the thread sits on the ready queues (see runqueue.h)
+    Thread *readyNext, *readyPrev;	// neighbours on a PriorityQueue
+    int readyLevel;		// priority it is queued at, or -1 if
+				// it is on no PriorityQueue
+    int readyIndex[NumHeapKinds];	// its place in a ThreadHeap of
+				// each kind, or -1
+    int readyOrder[NumHeapKinds];	// when it was put on each
+    //real-time: run ahead of L1-L3 (see Scheduler::SetRealTime); times
+    //are in ticks
+    bool IsRealTime() { return rtPeriod > 0; }
+    int rtPeriod;		// between its releases, or 0 if it is not
+				// real-time
+    int rtBudget;		// how long it may run in each period
+    int rtLeft;			// what is left of that, this period
+    int rtDeadline;		// the end of this period
+    bool rtThrottled;		// done with this period (used up its 
+				// budget, or gave up the rest)
+    //priority inheritance (see Lock::Acquire)
+    Lock *waitingFor;		// the lock it is waiting to acquire, or
+				// NULL
+    Lock *locksHeld;		// the locks it holds, chained through
+				// Lock::nextHeld
+    //-procs: could the thread move to another Nachos? (see Kernel::BalanceLoad)
+    void setAffinity(int proc) { affinity = proc; }
+    int getAffinity() { return affinity; }
+    bool HasRun() { return hasRun; }
+
+    void Checkpoint(int fd);	// write our state to a checkpoint file
+    static Thread *Restore(int fd);
+				// make a thread from what Checkpoint wrote
 
   private:
     // some of the private data for this class is listed above
     //MP3
     int priority;
+    int inherited;		// highest priority of a thread waiting for
+				// a lock it holds, or -1
     int startTime;
     double burstTime;
     int waitTime;
     bool jump;
+    double vruntime;
     //12/16 modified
     double thisTimeBurstTime;
+    bool userLevel;
+    int affinity;		// Nachos process the thread should stay
+				// in (-procs), or -1
+    bool hasRun;		// has it started?  only one that hasn't
+				// can be moved to another process
     
     int *stack; 	 	// Bottom of the stack 
 				// NULL if this is the main thread
@@ -152,8 +217,11 @@ class Thread {
   public:
     void SaveUserState();		// save user-level register state
     void RestoreUserState();		// restore user-level register state
+    void ClaimUserRegisters();		// save the state some other thread
+					// left in the machine's registers
 
     AddrSpace *space;			// User code this thread is running.
+    ThreadStatistics *usage;		// What it has used (see Statistics)
 };
 
 // external function, dummy routine whose sole job is to call Thread::Print
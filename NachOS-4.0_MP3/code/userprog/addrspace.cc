@@ -67,6 +67,30 @@ SwapHeader (NoffHeader *noffH)
 
 AddrSpace::AddrSpace()
 {
+    // with a TLB, pick an address space id that no other space is 
+    // using, so our TLB entries can stay in the TLB while other spaces
+    // run; if they are all taken, we make do without one
+    asid = -1;
+    if (kernel->machine->tlb != NULL) {
+        for (asid = 0; asid < NumASIDs && asidOwner[asid] != NULL; asid++)
+            ;
+        if (asid < NumASIDs) {
+            asidOwner[asid] = this;
+        } else {
+            asid = -1;
+        }
+    }
+    AddrSpace **last = &firstSpace;	// keep them in order of creation
+    while (*last != NULL) {
+        last = &(*last)->nextSpace;
+    }
+    *last = this;
+    nextSpace = NULL;
+    programName = NULL;
+    pcCounts = NULL;
+    pageTable = NULL;			// until Load
+    numPages = 0;
+
   /*
     pageTable = new TranslationEntry[NumPhysPages];
     for (int i = 0; i < NumPhysPages; i++) {
@@ -92,7 +116,40 @@ AddrSpace::~AddrSpace()
    for(int i=0;i<numPages;i++){
         usedPhysPage[pageTable[i].physicalPage] = false;
    }
+   if (kernel->machine->pageTable == pageTable) {
+        kernel->machine->FlushTranslations();  // frames may be reused
+   }
+   if (kernel->machine->tlb != NULL &&	// so is our address space id
+            (asid >= 0 || untaggedOwner == this)) {
+        for (int i = 0; i < kernel->machine->tlbSize; i++) {
+            if (kernel->machine->tlb[i].asid == asid) {
+                kernel->machine->tlb[i].valid = FALSE;
+            }
+        }
+   }
+   if (kernel->machine->pcCounts == pcCounts) {
+        kernel->machine->pcCounts = NULL;
+   }
+   if (asid >= 0) {
+        asidOwner[asid] = NULL;
+   }
+   if (untaggedOwner == this) {
+        untaggedOwner = NULL;
+   }
+   for (AddrSpace **space = &firstSpace; *space != NULL; 
+            space = &(*space)->nextSpace) {
+        if (*space == this) {
+            *space = nextSpace;
+            break;
+        }
+   }
+   if (loaded == this) {
+        loaded = NULL;
+   }
    delete pageTable;
+   if (pcCounts != NULL) {
+        delete [] pcCounts;
+   }
 }
 
 
@@ -107,6 +164,10 @@ AddrSpace::~AddrSpace()
 //----------------------------------------------------------------------
 
 bool AddrSpace::usedPhysPage[NumPhysPages] = {0};
+AddrSpace *AddrSpace::asidOwner[NumASIDs] = {NULL};
+AddrSpace *AddrSpace::untaggedOwner = NULL;
+AddrSpace *AddrSpace::firstSpace = NULL;
+AddrSpace *AddrSpace::loaded = NULL;
 bool AddrSpace::Load(char *fileName) 
 {
     OpenFile *executable = kernel->fileSystem->Open(fileName);
@@ -147,6 +208,8 @@ bool AddrSpace::Load(char *fileName)
         }
         usedPhysPage[j] = TRUE;
         //cout<<j<<" ";
+        kernel->machine->InvalidateDecodedPage(j);   // frame may still hold
+                                                      // the last owner's code
         pageTable[i].physicalPage = j;
         pageTable[i].valid = TRUE;
         pageTable[i].use = FALSE;
@@ -163,6 +226,11 @@ bool AddrSpace::Load(char *fileName)
 
     DEBUG(dbgAddr, "Initializing address space: " << numPages << ", " << size);
 
+    programName = fileName;
+    if (kernel->machine->Profiling()) {
+        pcCounts = new int[size / 4]();	// all zero
+    }
+
 // then, copy in the code and data segments into memory
 // Note: this code assumes that virtual address = physical address
     if (noffH.code.size > 0) {
@@ -186,9 +254,19 @@ bool AddrSpace::Load(char *fileName)
     if (noffH.readonlyData.size > 0) {
         DEBUG(dbgAddr, "Initializing read only data segment.");
 	DEBUG(dbgAddr, noffH.readonlyData.virtualAddr << ", " << noffH.readonlyData.size);
-        executable->ReadAt(
-		&(kernel->machine->mainMemory[noffH.readonlyData.virtualAddr]),
-			noffH.readonlyData.size, noffH.readonlyData.inFileAddr);
+        unsigned int vaddr = noffH.readonlyData.virtualAddr;
+        int inFileAddr = noffH.readonlyData.inFileAddr;
+        int left = noffH.readonlyData.size;
+        while (left > 0) {		// a page at a time, through the
+            int frame = pageTable[vaddr / PageSize].physicalPage; // table
+            int run = min(left, (int) (PageSize - vaddr % PageSize));
+            executable->ReadAt(&(kernel->machine->mainMemory[
+                    frame * PageSize + vaddr % PageSize]), run, inFileAddr);
+            kernel->machine->InvalidateDecodedPage(frame);
+            vaddr += run;
+            inFileAddr += run;
+            left -= run;
+        }
     }
 #endif
 
@@ -196,6 +274,68 @@ bool AddrSpace::Load(char *fileName)
     return TRUE;			// success
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::Checkpoint
+// 	Write our page table, and the name of the program we loaded, to
+//	a checkpoint file (see Kernel::Checkpoint).  The pages themselves
+//	are saved with the rest of mainMemory.
+//
+//	"fd" -- the open checkpoint file
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Checkpoint(int fd)
+{
+    int length = strlen(programName) + 1;
+
+    if (kernel->machine->tlb != NULL) {	// bring back the use and dirty
+        for (int i = 0; i < kernel->machine->tlbSize; i++) {	// bits
+            TranslationEntry *entry = &kernel->machine->tlb[i];
+            if (entry->valid && EntryOwner(entry) == this) {
+                pageTable[entry->virtualPage].use |= entry->use;
+                pageTable[entry->virtualPage].dirty |= entry->dirty;
+            }
+        }
+    }
+    WriteFile(fd, (char *) &numPages, sizeof(unsigned int));
+    WriteFile(fd, (char *) pageTable, numPages * sizeof(TranslationEntry));
+    WriteFile(fd, (char *) &length, sizeof(int));
+    WriteFile(fd, programName, length);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Restore
+// 	Read back a page table written by AddrSpace::Checkpoint, in place
+//	of loading a program.  The frames it maps must already be back
+//	in mainMemory, and marked as used.
+//
+//	"fd" -- the open checkpoint file
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Restore(int fd)
+{
+    int length;
+
+    Read(fd, (char *) &numPages, sizeof(unsigned int));
+    ASSERT(numPages <= NumPhysPages);
+    pageTable = new TranslationEntry[numPages];
+    Read(fd, (char *) pageTable, numPages * sizeof(TranslationEntry));
+    for (unsigned int i = 0; i < numPages; i++) {
+        ASSERT(usedPhysPage[pageTable[i].physicalPage]);
+    }
+    Read(fd, (char *) &length, sizeof(int));
+    programName = new char[length];
+    Read(fd, programName, length);
+
+    if (kernel->machine->Profiling()) {
+        pcCounts = new int[numPages * PageSize / 4];
+        for (unsigned int i = 0; i < numPages * PageSize / 4; i++) {
+            pcCounts[i] = 0;
+        }
+    }
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::Execute
 // 	Run a user program using the current thread
@@ -211,6 +351,7 @@ AddrSpace::Execute(char* fileName)
 
     kernel->currentThread->space = this;
 
+    kernel->currentThread->ClaimUserRegisters();
     this->InitRegisters();		// set the initial register values
     this->RestoreState();		// load page table register
 
@@ -268,8 +409,10 @@ AddrSpace::InitRegisters()
 
 void AddrSpace::SaveState() 
 {
-    pageTable = kernel->machine->pageTable;
-    numPages = kernel->machine->pageTableSize;
+    if (kernel->machine->tlb == NULL) {
+        pageTable = kernel->machine->pageTable;
+        numPages = kernel->machine->pageTableSize;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -277,16 +420,104 @@ void AddrSpace::SaveState()
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table.  With
+//	a TLB, just tell it our address space id: the entries of other
+//	spaces can stay in the TLB, since they won't match.  If we're
+//	profiling, the machine also needs our PC histogram.
+//
+//	The space the machine was set up for saves its state only now,
+//	not when its thread was switched out: as long as only its own
+//	threads, or kernel threads, run in between, it needn't be
+//	restored at all (see Scheduler::Run).
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
-    kernel->machine->pageTable = pageTable;
-    kernel->machine->pageTableSize = numPages;
+    if (loaded != NULL && loaded != this) {
+        loaded->SaveState();
+    }
+    if (kernel->machine->tlb != NULL) {
+        if (asid < 0 && untaggedOwner != this) {
+            // we share the untagged entries with the other spaces that
+            // got no id; flush the ones they left behind
+            for (int i = 0; i < kernel->machine->tlbSize; i++) {
+                TranslationEntry *entry = &kernel->machine->tlb[i];
+                if (entry->valid && entry->asid < 0) {
+                    if (untaggedOwner != NULL) {
+                        TranslationEntry *pte = 
+                            &untaggedOwner->pageTable[entry->virtualPage];
+                        pte->use = pte->use || entry->use;
+                        pte->dirty = pte->dirty || entry->dirty;
+                    }
+                    entry->valid = FALSE;
+                }
+            }
+            untaggedOwner = this;
+        }
+        kernel->machine->currentASID = asid;
+    } else {
+        kernel->machine->pageTable = pageTable;
+        kernel->machine->pageTableSize = numPages;
+    }
+    kernel->machine->pcCounts = pcCounts;
+    kernel->machine->pcCountsSize = numPages * PageSize / 4;
+    if (kernel->machine->trace != NULL) {
+        kernel->machine->trace->Record(TraceSpace, asid, 0);
+    }
+    kernel->machine->FlushTranslations();
+    loaded = this;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::RefillTLB
+// 	Handle a TLB miss on "vaddr": copy its page table entry into the
+//	TLB entry the machine suggests replacing, tagged with our address
+//	space id.  The use and dirty bits of the entry being replaced are
+//	written back to the page table it came from first.
+//
+//	Returns FALSE if vaddr is not a valid address in this space, in
+//	which case it's a real fault and not just a TLB miss.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::RefillTLB(unsigned int vaddr)
+{
+    unsigned int vpn = vaddr / PageSize;
+    TranslationEntry *entry;
+
+    if (vpn >= numPages || !pageTable[vpn].valid) {
+        return FALSE;
+    }
+    entry = &kernel->machine->tlb[kernel->machine->TLBVictim()];
+    if (entry->valid && EntryOwner(entry) != NULL) {
+        TranslationEntry *pte = 
+                &EntryOwner(entry)->pageTable[entry->virtualPage];
+        pte->use = pte->use || entry->use;
+        pte->dirty = pte->dirty || entry->dirty;
+    }
+    DEBUG(dbgAddr, "TLB refill: virtual page " << vpn << " -> " 
+                << pageTable[vpn].physicalPage << ", asid " << asid);
+    *entry = pageTable[vpn];
+    entry->asid = asid;
+    return TRUE;
 }
 
 
+//----------------------------------------------------------------------
+// AddrSpace::EntryOwner
+// 	Return the space a valid TLB entry was loaded from, or NULL if
+//	that space is gone.
+//----------------------------------------------------------------------
+
+AddrSpace *
+AddrSpace::EntryOwner(TranslationEntry *entry)
+{
+    if (entry->asid < 0) {
+        return untaggedOwner;
+    }
+    return asidOwner[entry->asid];
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::Translate
 //  Translate the virtual address in _vaddr_ to a physical address
@@ -309,6 +540,10 @@ AddrSpace::Translate(unsigned int vaddr, unsigned int *paddr, int isReadWrite)
 
     pte = &pageTable[vpn];
 
+    if(!pte->valid) {
+        return PageFaultException;
+    }
+
     if(isReadWrite && pte->readOnly) {
         return ReadOnlyException;
     }
@@ -337,6 +572,321 @@ AddrSpace::Translate(unsigned int vaddr, unsigned int *paddr, int isReadWrite)
     return NoException;
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::CopyIn
+//  Copy "size" bytes of user memory, starting at virtual address
+//  _vaddr_, into the kernel buffer _buf_.  The page table is looked
+//  at once per page, and each run within a page is copied whole.
+//  Return FALSE if part of the buffer isn't mapped; the system call
+//  then fails, rather than the program.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CopyIn(unsigned int vaddr, char *buf, int size)
+{
+    unsigned int paddr;
+    ExceptionType exception;
+    int run;
+
+    while (size > 0) {
+        exception = Translate(vaddr, &paddr, 0);
+        if (exception != NoException) {
+            DEBUG(dbgAddr, "Bad user buffer at " << vaddr);
+            return FALSE;
+        }
+        run = min(size, (int) (PageSize - vaddr % PageSize));
+        memcpy(buf, &kernel->machine->mainMemory[paddr], run);
+        vaddr += run;
+        buf += run;
+        size -= run;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyOut
+//  Copy "size" bytes from the kernel buffer _buf_ to user memory,
+//  starting at virtual address _vaddr_, a page at a time.  The pages
+//  are marked dirty; as the machine didn't write them, it has to be
+//  told to forget any instructions it decoded from them.  Return
+//  FALSE if part of the buffer isn't mapped or is read-only.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CopyOut(unsigned int vaddr, char *buf, int size)
+{
+    unsigned int paddr;
+    ExceptionType exception;
+    int run;
+
+    while (size > 0) {
+        exception = Translate(vaddr, &paddr, 1);
+        if (exception != NoException) {
+            DEBUG(dbgAddr, "Bad user buffer at " << vaddr);
+            return FALSE;
+        }
+        run = min(size, (int) (PageSize - vaddr % PageSize));
+        memcpy(&kernel->machine->mainMemory[paddr], buf, run);
+        kernel->machine->InvalidateDecodedPage(paddr / PageSize);
+        vaddr += run;
+        buf += run;
+        size -= run;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CanWrite
+//  Return TRUE if all "size" bytes of user memory from virtual
+//  address _vaddr_ are mapped and writable, so that a later CopyOut
+//  of that many bytes will succeed.  Lets a system call refuse a bad
+//  buffer before it consumes any input it would then have to drop.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CanWrite(unsigned int vaddr, int size)
+{
+    unsigned int paddr;
+    int run;
+
+    while (size > 0) {
+        if (Translate(vaddr, &paddr, 1) != NoException) {
+            DEBUG(dbgAddr, "Bad user buffer at " << vaddr);
+            return FALSE;
+        }
+        run = min(size, (int) (PageSize - vaddr % PageSize));
+        vaddr += run;
+        size -= run;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyInString
+//  Copy a null-terminated string from user memory, starting at
+//  virtual address _vaddr_, into the kernel buffer _buf_, which
+//  holds "maxSize" bytes.  Each page is searched for the null with
+//  memchr, rather than a byte at a time.  Return FALSE, with an
+//  empty string in _buf_, if the string doesn't fit or runs off the
+//  end of the mapped memory.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CopyInString(unsigned int vaddr, char *buf, int maxSize)
+{
+    unsigned int paddr;
+    ExceptionType exception;
+    char *start = buf, *end;
+    int run;
+
+    ASSERT(maxSize > 0);
+    while (maxSize > 0) {
+        exception = Translate(vaddr, &paddr, 0);
+        if (exception != NoException) {
+            *start = '\0';
+            DEBUG(dbgAddr, "Bad user string at " << vaddr);
+            return FALSE;
+        }
+        run = min(maxSize, (int) (PageSize - vaddr % PageSize));
+        end = (char *) memchr(&kernel->machine->mainMemory[paddr], '\0', run);
+        if (end != NULL) {
+            memcpy(buf, &kernel->machine->mainMemory[paddr], 
+                   end - &kernel->machine->mainMemory[paddr] + 1);
+            return TRUE;
+        }
+        memcpy(buf, &kernel->machine->mainMemory[paddr], run);
+        vaddr += run;
+        buf += run;
+        maxSize -= run;
+    }
+    *start = '\0';
+    return FALSE;			// too long
+}
+
+
 
 
 
+//----------------------------------------------------------------------
+// ReadProcedures
+// 	Find the procedures in the symbol table of "coffName", the COFF 
+//	file that coff2noff turned a program into, so that a profile
+//	can say which procedure each PC is in -- the NOFF file doesn't
+//	keep any symbols.  Only external symbols are looked at, which
+//	covers everything but static procedures.
+//
+//	Returns how many procedures were found (0 if the COFF file 
+//	isn't there), and sets "procs" to them, sorted by address.
+//----------------------------------------------------------------------
+
+// The parts of a MIPS COFF file we need: the file header points to 
+// the symbolic header, which locates the table of external symbols 
+// and the strings holding their names.  Offsets are in bytes.
+
+const int CoffSymbolicHeader = 8;	// in the file header
+const int CoffExtStrings = 68;		// in the symbolic header...
+const int CoffNumExts = 88;
+const int CoffExts = 92;
+const int CoffSymbolicHeaderSize = 96;
+const int CoffExtSize = 16;		// in each external symbol...
+const int CoffExtName = 4;
+const int CoffExtValue = 8;
+const int CoffExtType = 12;		// low 6 bits
+const int CoffProc = 6;			// symbol types of procedures
+const int CoffStaticProc = 14;
+const unsigned short CoffMagic = 0x0162;
+
+class Procedure {
+  public:
+    int address;			// where the procedure starts
+    char *name;
+};
+
+static int
+CompareProcedures(const void *a, const void *b)
+{
+    return ((Procedure *) a)->address - ((Procedure *) b)->address;
+}
+
+static int
+CoffWord(char *image, int offset)
+{
+    return (int) WordToHost(*(unsigned int *) &image[offset]);
+}
+
+static int
+ReadProcedures(char *coffName, Procedure **procs)
+{
+    int fd, size, header, numExts, exts, strings, name, count = 0;
+    char *image;
+
+    *procs = NULL;
+    fd = OpenForReadWrite(coffName, FALSE);
+    if (fd < 0) {
+        return 0;
+    }
+    Lseek(fd, 0, SEEK_END);
+    size = Tell(fd);
+    Lseek(fd, 0, SEEK_SET);
+    image = new char[size + 1];
+    Read(fd, image, size);
+    Close(fd);
+    image[size] = '\0';		// in case the last name isn't ended
+
+    if (size < CoffSymbolicHeader + 4 
+        || ShortToHost(*(unsigned short *) image) != CoffMagic) {
+        delete [] image;
+        return 0;
+    }
+    header = CoffWord(image, CoffSymbolicHeader);
+    if (header <= 0 || header + CoffSymbolicHeaderSize > size) {
+        delete [] image;
+        return 0;			// stripped
+    }
+    numExts = CoffWord(image, header + CoffNumExts);
+    exts = CoffWord(image, header + CoffExts);
+    strings = CoffWord(image, header + CoffExtStrings);
+    if (numExts <= 0 || exts + numExts * CoffExtSize > size) {
+        delete [] image;
+        return 0;
+    }
+
+    *procs = new Procedure[numExts];
+    for (int i = 0; i < numExts; i++) {
+        char *ext = &image[exts + i * CoffExtSize];
+        int type = CoffWord(ext, CoffExtType) & 0x3f;
+
+        name = strings + CoffWord(ext, CoffExtName);
+        if ((type == CoffProc || type == CoffStaticProc) 
+            && name >= 0 && name < size) {
+            (*procs)[count].address = CoffWord(ext, CoffExtValue);
+            (*procs)[count].name = new char[strlen(&image[name]) + 1];
+            strcpy((*procs)[count].name, &image[name]);
+            count++;
+        }
+    }
+    qsort(*procs, count, sizeof(Procedure), CompareProcedures);
+    delete [] image;
+    return count;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PrintProfile
+// 	Print the PCs at which this program ran the most instructions,
+//	from the histogram the machine kept while we were profiling.  If
+//	the COFF file the program was made from is next to it, say 
+//	which procedure each PC is in.
+//----------------------------------------------------------------------
+
+static int *sortCounts;		// what CompareCounts sorts by
+
+static int
+CompareCounts(const void *a, const void *b)
+{
+    int x = *(int *) a, y = *(int *) b;
+
+    if (sortCounts[x] != sortCounts[y])
+        return sortCounts[y] - sortCounts[x];
+    return x - y;            // ties in address order
+}
+
+void
+AddrSpace::PrintProfile()
+{
+    const int NumHotPCs = 20;		// how many we print
+    int numWords = numPages * PageSize / 4;
+    int *order, numRun = 0, total = 0, numProcs, i;
+    Procedure *procs;
+    char coffName[256], where[80], buf[80];
+
+    if (pcCounts == NULL) {
+        return;
+    }
+    order = new int[numWords];
+    for (i = 0; i < numWords; i++) {
+        if (pcCounts[i] > 0) {
+            order[numRun++] = i;
+            total += pcCounts[i];
+        }
+    }
+    sortCounts = pcCounts;
+    qsort(order, numRun, sizeof(int), CompareCounts);
+
+    snprintf(coffName, sizeof(coffName), "%s.coff", programName);
+    numProcs = ReadProcedures(coffName, &procs);
+
+    cout << "Hot PCs in " << programName << ": " << total 
+         << " instructions\n";
+    for (i = 0; i < numRun && i < NumHotPCs; i++) {
+        int pc = order[i] * 4;
+        int lo = 0, hi = numProcs - 1;
+
+        while (lo < hi) {		// last procedure starting at or 
+            int mid = (lo + hi + 1) / 2;	// before pc
+            if (procs[mid].address <= pc) {
+                lo = mid;
+            } else {
+                hi = mid - 1;
+            }
+        }
+        if (numProcs > 0 && procs[lo].address <= pc) {
+            snprintf(where, sizeof(where), "%s+0x%x", procs[lo].name,
+                     pc - procs[lo].address);
+        } else {
+            where[0] = '\0';
+        }
+        sprintf(buf, "  0x%06x %10d  %5.1f%%", pc, pcCounts[order[i]],
+                100.0 * pcCounts[order[i]] / total);
+        cout << buf;
+        if (where[0] != '\0') {
+            cout << "  " << where;
+        }
+        cout << "\n";
+    }
+
+    for (i = 0; i < numProcs; i++) {
+        delete [] procs[i].name;
+    }
+    delete [] procs;
+    delete [] order;
+}
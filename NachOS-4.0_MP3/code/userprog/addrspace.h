@@ -33,19 +33,58 @@ class AddrSpace {
 
     void SaveState();			// Save/restore address space-specific
     void RestoreState();		// info on a context switch 
+    bool IsLoaded() { return loaded == this; }
+					// is the machine still set up
+					// for this space?
     static bool usedPhysPage[NumPhysPages];
 
+    bool RefillTLB(unsigned int vaddr);	// Load the translation for
+					// vaddr into the TLB, after a miss
+    static AddrSpace *asidOwner[NumASIDs];
+    static AddrSpace *untaggedOwner;	// The space that got no id of its
+					// own whose entries are in the TLB
+    static AddrSpace *firstSpace;	// Every space there is, in order of
+    AddrSpace *nextSpace;		// creation
+
+    void PrintProfile();		// Print the PCs where this program
+					// spent the most instructions
+
+    void Checkpoint(int fd);		// Write our page table to a
+    void Restore(int fd);		// checkpoint file, or read it back
+
     // Translate virtual address _vaddr_
     // to physical address _paddr_. _mode_
     // is 0 for Read, 1 for Write.
     ExceptionType Translate(unsigned int vaddr, unsigned int *paddr, int mode);
 
+    // Copy between the kernel and user memory, a page at a time, for
+    // system calls.  Each returns FALSE if the user buffer isn't all
+    // there (or, for CopyOut, isn't writable).
+    bool CopyIn(unsigned int vaddr, char *buf, int size);
+    bool CopyOut(unsigned int vaddr, char *buf, int size);
+    bool CopyInString(unsigned int vaddr, char *buf, int maxSize);
+					// as CopyIn, but stop after the
+					// null; FALSE if there isn't one
+    bool CanWrite(unsigned int vaddr, int size);
+					// would CopyOut of "size" bytes
+					// succeed?
+
   private:
     TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+    int asid;				// Tags our entries in the TLB, or -1
+					// if there is no TLB, or every id
+					// was taken (see RestoreState)
+    static AddrSpace *loaded;		// The space the machine is set up
+					// for, or NULL
+    char *programName;			// File the program was loaded from
+    int *pcCounts;			// Instructions run at each word of
+					// the space, if we're profiling
 
+    static AddrSpace *EntryOwner(TranslationEntry *entry);
+					// the space a TLB entry came from
     void InitRegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
 
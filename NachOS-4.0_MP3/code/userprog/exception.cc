@@ -25,6 +25,11 @@
 #include "main.h"
 #include "syscall.h"
 #include "ksyscall.h"
+
+// The longest string (file name or message) a system call takes,
+// including the null at the end.
+const int MaxStringLength = 256;
+
 //----------------------------------------------------------------------
 // ExceptionHandler
 // 	Entry point into the Nachos kernel.  Called when a user program
@@ -84,7 +89,14 @@ ExceptionHandler(ExceptionType which)
 			DEBUG(dbgSys, "Message received.\n");
 			val = kernel->machine->ReadRegister(4);
 			{
-			char *msg = &(kernel->machine->mainMemory[val]);
+			char msg[MaxStringLength];
+			if (!kernel->currentThread->space->CopyInString(val, msg, MaxStringLength)) {
+				kernel->machine->WriteRegister(2, -1);	// bad string
+				kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+				kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+				kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+				return;
+			}
 			cout << msg << endl;
 			}
 			SysHalt();
@@ -93,9 +105,11 @@ ExceptionHandler(ExceptionType which)
 		case SC_Create:
 			val = kernel->machine->ReadRegister(4);
 			{
-			char *filename = &(kernel->machine->mainMemory[val]);
-			//cout << filename << endl;
-			status = SysCreate(filename);
+			char filename[MaxStringLength];
+			if (kernel->currentThread->space->CopyInString(val, filename, MaxStringLength))
+				status = SysCreate(filename);
+			else
+				status = 0;
 			kernel->machine->WriteRegister(2, (int) status);
 			}
 			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
@@ -108,8 +122,11 @@ ExceptionHandler(ExceptionType which)
 		case SC_Open:
 			val = kernel->machine->ReadRegister(4);
                         {
-                        char *filename = &(kernel->machine->mainMemory[val]);
-			id = SysOpen(filename);
+                        char filename[MaxStringLength];
+                        if (kernel->currentThread->space->CopyInString(val, filename, MaxStringLength))
+                                id = SysOpen(filename);
+                        else
+                                id = -1;
                         kernel->machine->WriteRegister(2, (int) id);
                         }
                         kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
@@ -121,11 +138,16 @@ ExceptionHandler(ExceptionType which)
 		
 		case SC_Write:
 			val = kernel->machine->ReadRegister(4);
-                        buf = &(kernel->machine->mainMemory[val]);
 			size = kernel->machine->ReadRegister(5);
 			id = kernel->machine->ReadRegister(6);
                         {
-                        status = SysWrite(buf, size, id);
+                        status = -1;
+                        if (size >= 0 && size <= MemorySize) {	// no user
+                                buf = new char[size + 1];		// buffer is bigger
+                                if (kernel->currentThread->space->CopyIn(val, buf, size))
+                                        status = SysWrite(buf, size, id);
+                                delete [] buf;
+                        }
                         kernel->machine->WriteRegister(2, (int) status);
                         }
                         kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
@@ -137,11 +159,21 @@ ExceptionHandler(ExceptionType which)
 		
 		case SC_Read:
                         val = kernel->machine->ReadRegister(4);
-                        buf = &(kernel->machine->mainMemory[val]);
                         size = kernel->machine->ReadRegister(5);
                         id = kernel->machine->ReadRegister(6);
                         {
-                        status = SysRead(buf, size, id);
+                        status = -1;
+                        // check the whole buffer before reading, so that
+                        // no console input is consumed and then lost
+                        if (size >= 0 && size <= MemorySize	// no user buffer is bigger
+                            && kernel->currentThread->space->CanWrite(val, size)) {
+                                buf = new char[size + 1];
+                                status = SysRead(buf, size, id);
+                                if (status > 0 && 
+                                    !kernel->currentThread->space->CopyOut(val, buf, status))
+                                        status = -1;
+                                delete [] buf;
+                        }
                         kernel->machine->WriteRegister(2, (int) status);
                         }
                         kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
@@ -188,6 +220,39 @@ ExceptionHandler(ExceptionType which)
 			return;	
 			ASSERTNOTREACHED();
 		        break;
+		case SC_ThreadYield:
+			DEBUG(dbgSys, "Thread yield\n");
+			SysThreadYield();
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+                        kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+                        kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+
+		case SC_RealTime:
+			DEBUG(dbgSys, "RealTime period " << kernel->machine->ReadRegister(4) << ", budget " << kernel->machine->ReadRegister(5) << "\n");
+			val = SysRealTime((int)kernel->machine->ReadRegister(4),
+				(int)kernel->machine->ReadRegister(5));
+			kernel->machine->WriteRegister(2, val);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+                        kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+                        kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_Usage:
+			DEBUG(dbgSys, "Usage id " << kernel->machine->ReadRegister(4) << ", what " << kernel->machine->ReadRegister(5) << "\n");
+			val = SysUsage((int)kernel->machine->ReadRegister(4),
+				(int)kernel->machine->ReadRegister(5));
+			kernel->machine->WriteRegister(2, val);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+                        kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+                        kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+
 		case SC_Exit:
 			DEBUG(dbgAddr, "Program exit\n");
             val=kernel->machine->ReadRegister(4);
@@ -199,6 +264,18 @@ ExceptionHandler(ExceptionType which)
 			break;
 		}
 		break;
+	case PageFaultException:
+		// with a TLB, this is usually just a miss: load the
+		// translation and retry the instruction
+		if (kernel->machine->tlb != NULL &&
+		    kernel->currentThread->space->RefillTLB(
+			kernel->machine->ReadRegister(BadVAddrReg))) {
+			return;
+		}
+		// a real page fault: no valid page table entry
+		kernel->currentThread->usage->numPageFaults++;
+		cerr << "Unexpected user mode exception " << (int)which << "\n";
+		break;
 	default:
 		cerr << "Unexpected user mode exception " << (int)which << "\n";
 		break;
@@ -60,6 +60,47 @@ int SysClose(OpenFileId id)
 	return kernel->interrupt->Close(id);	
 }
 
+//real-time scheduling class
+void SysThreadYield()
+{
+	if (kernel->currentThread->IsRealTime())
+		kernel->scheduler->WaitForPeriod();
+	else
+		kernel->currentThread->Yield();
+}
+
+int SysRealTime(int period, int budget)
+{
+	return kernel->scheduler->SetRealTime(kernel->currentThread, 
+						period, budget) ? 1 : 0;
+}
+
+int SysUsage(int id, int what)
+{
+	ThreadStatistics *usage;
+
+	if (id == -1)
+		usage = kernel->currentThread->usage;
+	else
+		usage = kernel->stats->FindThread(id);
+	if (usage == NULL)
+		return -1;
+	switch (what) {
+	  case USAGE_USER_TICKS:	return usage->userTicks;
+	  case USAGE_SYSTEM_TICKS:	return usage->systemTicks;
+	  case USAGE_READY_TICKS:	return usage->readyTicks;
+	  case USAGE_VOLUNTARY:		return usage->numVoluntarySwitches;
+	  case USAGE_INVOLUNTARY:	return usage->numInvoluntarySwitches;
+	  case USAGE_PAGE_FAULTS:	return usage->numPageFaults;
+	  case USAGE_DISK_READS:	return usage->numDiskReads;
+	  case USAGE_DISK_WRITES:	return usage->numDiskWrites;
+	  case USAGE_CONSOLE_READS:	return usage->numConsoleCharsRead;
+	  case USAGE_CONSOLE_WRITES:	return usage->numConsoleCharsWritten;
+	  case USAGE_LOCK_TICKS:	return usage->lockTicks;
+	}
+	return -1;
+}
+
 
 
 
@@ -49,6 +49,8 @@ SynchConsoleInput::GetChar()
     lock->Acquire();
     waitFor->P();	// wait for EOF or a char to be available.
     ch = consoleInput->GetChar();
+    if (ch != EOF)
+	kernel->currentThread->usage->numConsoleCharsRead++;
     lock->Release();
     return ch;
 }
@@ -102,6 +104,7 @@ SynchConsoleOutput::PutChar(char ch)
 {
     lock->Acquire();
     consoleOutput->PutChar(ch);
+    kernel->currentThread->usage->numConsoleCharsWritten++;
     waitFor->P();
     lock->Release();
 }
@@ -110,6 +113,7 @@ void SynchConsoleOutput::Put_IntToChar(char *text)
 {
     lock->Acquire();
     consoleOutput->Put_IntToChar(text);
+    kernel->currentThread->usage->numConsoleCharsWritten++;
     waitFor->P();
     lock->Release();
 }
@@ -38,6 +38,8 @@
 #define SC_MSG		100
 
 #define SC_PrintInt	16
+#define SC_RealTime	17
+#define SC_Usage	18
 
 #ifndef IN_ASM
 
@@ -164,10 +166,41 @@ int Close(OpenFileId id);
 ThreadId ThreadFork(void (*func)());
 
 /* Yield the CPU to another runnable thread, whether in this address space 
- * or not. 
+ * or not.  A real-time thread (see RealTime) is done for this period: it
+ * gives up the rest of its budget, and waits for its next period.
  */
 void ThreadYield();	
 
+/* Make this thread real-time: in every "period" ticks, it may run for 
+ * "budget" of them, ahead of any thread that isn't real-time, and the 
+ * real-time thread whose period ends first runs first.  A thread that 
+ * uses up its budget waits for its next period.  Returns 1 if the 
+ * thread is now real-time, or 0 if the real-time threads would need
+ * more than the whole CPU between them (or the budget is longer than 
+ * the period).  A period of 0 makes it an ordinary thread again.
+ */
+int RealTime(int period, int budget);
+
+/* What Usage can report about a program. */
+#define USAGE_USER_TICKS	0	/* ticks running user code */
+#define USAGE_SYSTEM_TICKS	1	/* ticks in the kernel on its behalf */
+#define USAGE_READY_TICKS	2	/* ticks waiting to run */
+#define USAGE_VOLUNTARY		3	/* times it gave up the CPU to wait */
+#define USAGE_INVOLUNTARY	4	/* times it was switched out while 
+					 * still ready to run */
+#define USAGE_PAGE_FAULTS	5
+#define USAGE_DISK_READS	6	/* disk sectors read */
+#define USAGE_DISK_WRITES	7	/* and written */
+#define USAGE_CONSOLE_READS	8	/* console characters read */
+#define USAGE_CONSOLE_WRITES	9	/* and written */
+#define USAGE_LOCK_TICKS	10	/* ticks waiting to acquire locks */
+
+/* Return how much of "what" (one of the USAGE_ values above) the program
+ * "id" has used so far -- finished or not -- or the calling program, if
+ * "id" is -1.  Returns -1 if there has been no such program.
+ */
+int Usage(SpaceId id, int what);
+
 /*
  * Blocks current thread until lokal thread ThreadID exits with ThreadExit.
  * Function returns the ExitCode of ThreadExit() of the exiting thread.